@@ -0,0 +1,356 @@
+#pragma once
+#include "logging.h"
+#include <stdint.h>
+#include <string.h> // memcpy, strchr
+#include <string>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <chrono>
+#include <type_traits>
+#include <unordered_map>
+#include <rpp/strview.h>
+#include <rpp/sockets.h>
+
+// errno of a failed call, for HotLog %s arguments: captured as an int, printed with strerror
+struct LogErrno { int code; };
+
+/**
+ * --async-log: hot path messages become binary records in a lock-free ring, a flusher thread
+ * formats and prints them, so a slow console never stalls the send and receive loops.
+ *
+ * A record only stores the format literal and the raw argument values, string arguments are
+ * copied into the record since they may be temporaries. IPv4 addresses and LogErrno are stored
+ * as integers and only turned into text by the flusher, so a failing send doesn't allocate
+ * or call strerror on the packet path. Formatting happens on the flusher,
+ * which also rate limits each call site to RATE_LIMIT messages per second and reports how
+ * many repeats it suppressed. If the ring is full, records are dropped and counted.
+ *
+ * Without --async-log the HotLog macros format the same record and print it right away.
+ */
+struct AsyncLog
+{
+    enum Level : uint8_t { INFO, WARNING, ERROR };
+    static constexpr int CAPACITY = 4096; // power of 2
+    static constexpr int MAX_ARGS = 10;
+    static constexpr int MAX_STRINGS = 160; // bytes of copied string arguments per record
+    static constexpr int RATE_LIMIT = 20; // messages per call site per second
+    static constexpr uint64_t NULL_STRING = ~0ull;
+
+    // how a %s argument is stored
+    enum Kind : uint8_t { VALUE, STRING, IPV4, ERRNO };
+
+    struct Record {
+        const char* format;
+        Level level;
+        uint8_t numArgs;
+        uint8_t stringBytes;
+        uint64_t args[MAX_ARGS]; // integers, double bits, offsets into strings, address << 16 | port, or errno
+        Kind kinds[MAX_ARGS];
+        char strings[MAX_STRINGS];
+    };
+
+    // bounded multi-producer ring, each cell's sequence says whose turn it is
+    struct Cell {
+        std::atomic<uint64_t> sequence;
+        Record record;
+    };
+
+    static inline std::atomic<bool> enabled { false };
+
+    std::unique_ptr<Cell[]> cells;
+    alignas(64) std::atomic<uint64_t> enqueuePos { 0 };
+    alignas(64) std::atomic<uint64_t> dequeuePos { 0 }; // only written by the flusher
+    std::atomic<int64_t> dropped { 0 }; // the ring was full
+    std::atomic<bool> stopping { false };
+    std::thread flusher;
+
+    static AsyncLog& instance() noexcept
+    {
+        static AsyncLog log;
+        return log;
+    }
+
+    static bool running() noexcept { return enabled.load(std::memory_order_relaxed); }
+
+    void start() noexcept
+    {
+        if (flusher.joinable())
+            return;
+        cells = std::make_unique<Cell[]>(CAPACITY);
+        for (uint64_t i = 0; i < CAPACITY; ++i)
+            cells[i].sequence.store(i, std::memory_order_relaxed);
+        flusher = std::thread{[this] { flushLoop(); }};
+        enabled = true;
+    }
+
+    ~AsyncLog() noexcept
+    {
+        if (!flusher.joinable())
+            return;
+        enabled = false;
+        stopping = true;
+        flusher.join();
+    }
+
+    // any thread: waits until everything logged so far is printed, so summaries don't interleave with it
+    static void flush() noexcept
+    {
+        if (!running())
+            return;
+        AsyncLog& log = instance();
+        uint64_t target = log.enqueuePos.load(std::memory_order_acquire);
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+        while (log.dequeuePos.load(std::memory_order_acquire) < target &&
+               std::chrono::steady_clock::now() < deadline)
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+
+    // any thread, lock-free: copies the arguments, the format must be a string literal
+    template<class... Args>
+    void push(Level level, const char* format, const Args&... args) noexcept
+    {
+        static_assert(sizeof...(Args) <= MAX_ARGS, "too many arguments for AsyncLog");
+        uint64_t pos = enqueuePos.load(std::memory_order_relaxed);
+        Cell* cell;
+        while (true) {
+            cell = &cells[pos & (CAPACITY - 1)];
+            uint64_t seq = cell->sequence.load(std::memory_order_acquire);
+            int64_t diff = int64_t(seq) - int64_t(pos);
+            if (diff == 0) {
+                if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            } else if (diff < 0) {
+                dropped.fetch_add(1, std::memory_order_relaxed);
+                return;
+            } else {
+                pos = enqueuePos.load(std::memory_order_relaxed);
+            }
+        }
+        fill(cell->record, level, format, args...);
+        cell->sequence.store(pos + 1, std::memory_order_release);
+    }
+
+    // without --async-log: the same formatting, printed by the calling thread
+    template<class... Args>
+    static void printNow(Level level, const char* format, const Args&... args) noexcept
+    {
+        static_assert(sizeof...(Args) <= MAX_ARGS, "too many arguments for AsyncLog");
+        Record r;
+        fill(r, level, format, args...);
+        char line[1024];
+        formatRecord(r, line, sizeof(line));
+        print(level, line);
+    }
+
+private:
+    AsyncLog() noexcept = default;
+
+    template<class... Args>
+    static void fill(Record& r, Level level, const char* format, const Args&... args) noexcept
+    {
+        r.format = format;
+        r.level = level;
+        r.numArgs = 0;
+        r.stringBytes = 0;
+        (putArg(r, args), ...);
+    }
+
+    static void putString(Record& r, const char* s, size_t len) noexcept
+    {
+        r.kinds[r.numArgs] = STRING;
+        if (!s) {
+            r.args[r.numArgs++] = NULL_STRING;
+            return;
+        }
+        size_t room = size_t(MAX_STRINGS - r.stringBytes - 1);
+        if (len > room) len = room; // truncated, the message is still useful
+        r.args[r.numArgs++] = r.stringBytes;
+        memcpy(r.strings + r.stringBytes, s, len);
+        r.stringBytes += uint8_t(len);
+        r.strings[r.stringBytes++] = '\0';
+    }
+
+    template<class T>
+    static void putArg(Record& r, const T& v) noexcept
+    {
+        using U = std::decay_t<T>;
+        r.kinds[r.numArgs] = VALUE; // strings, addresses and errno set their own kind
+        if constexpr (std::is_base_of_v<rpp::ipaddress, U>) {
+            if (v.Address.Family == rpp::AF_IPv4) {
+                r.kinds[r.numArgs] = IPV4;
+                r.args[r.numArgs++] = (uint64_t(uint32_t(v.Address.Addr4)) << 16) | uint16_t(v.Port);
+            } else {
+                std::string str = v.str(); // IPv6 is not used by the tests, so it may allocate
+                putString(r, str.data(), str.size());
+            }
+        } else if constexpr (std::is_same_v<U, LogErrno>) {
+            r.kinds[r.numArgs] = ERRNO;
+            r.args[r.numArgs++] = uint64_t(uint32_t(v.code));
+        } else if constexpr (std::is_same_v<U, char*> || std::is_same_v<U, const char*>) {
+            putString(r, v, v ? strlen(v) : 0);
+        } else if constexpr (std::is_same_v<U, std::string>) {
+            putString(r, v.data(), v.size());
+        } else if constexpr (std::is_same_v<U, rpp::strview>) {
+            putString(r, v.str, size_t(v.len));
+        } else if constexpr (std::is_floating_point_v<U>) {
+            double d = double(v);
+            memcpy(&r.args[r.numArgs++], &d, sizeof(d));
+        } else if constexpr (std::is_pointer_v<U>) {
+            r.args[r.numArgs++] = uint64_t(uintptr_t(v));
+        } else if constexpr (std::is_enum_v<U> || std::is_signed_v<U>) {
+            r.args[r.numArgs++] = uint64_t(int64_t(v));
+        } else {
+            r.args[r.numArgs++] = uint64_t(v);
+        }
+    }
+
+    // %s text of an IPV4 or ERRNO argument
+    static const char* argText(Kind kind, uint64_t v, char* buf, int size) noexcept
+    {
+        if (kind == ERRNO)
+            return strerror(int(uint32_t(v))); // only the flusher or a synchronous HotLog calls this
+        uint32_t addr = uint32_t(v >> 16); // network byte order
+        uint8_t ip[4];
+        memcpy(ip, &addr, sizeof(ip));
+        snprintf(buf, size, "%u.%u.%u.%u:%u", ip[0], ip[1], ip[2], ip[3], unsigned(v & 0xFFFF));
+        return buf;
+    }
+
+    // printf of one record, every conversion gets the argument type that the spec asks for
+    static void formatRecord(const Record& r, char* out, int size) noexcept
+    {
+        int len = 0;
+        int argIndex = 0;
+        const char* f = r.format;
+        while (*f && len < size - 1) {
+            if (*f != '%') { out[len++] = *f++; continue; }
+            if (f[1] == '%') { out[len++] = '%'; f += 2; continue; }
+            char spec[32];
+            int n = 0;
+            spec[n++] = *f++;
+            while (*f && strchr("-+ #0123456789.", *f) && n < 24) spec[n++] = *f++;
+            while (*f && strchr("hlLzjt", *f)) ++f; // length modifiers are replaced below
+            char conv = *f ? *f++ : 's';
+            Kind kind = argIndex < r.numArgs ? r.kinds[argIndex] : VALUE;
+            uint64_t v = argIndex < r.numArgs ? r.args[argIndex++] : 0;
+            int w;
+            if (strchr("di", conv)) {
+                spec[n++] = 'l'; spec[n++] = 'l'; spec[n++] = conv; spec[n] = '\0';
+                w = snprintf(out + len, size - len, spec, (long long)v);
+            } else if (strchr("uxXo", conv)) {
+                spec[n++] = 'l'; spec[n++] = 'l'; spec[n++] = conv; spec[n] = '\0';
+                w = snprintf(out + len, size - len, spec, (unsigned long long)v);
+            } else if (strchr("fFeEgGaA", conv)) {
+                double d;
+                memcpy(&d, &v, sizeof(d));
+                spec[n++] = conv; spec[n] = '\0';
+                w = snprintf(out + len, size - len, spec, d);
+            } else if (conv == 'c') {
+                spec[n++] = conv; spec[n] = '\0';
+                w = snprintf(out + len, size - len, spec, int(v));
+            } else if (conv == 'p') {
+                spec[n++] = conv; spec[n] = '\0';
+                w = snprintf(out + len, size - len, spec, (void*)uintptr_t(v));
+            } else {
+                spec[n++] = 's'; spec[n] = '\0';
+                char text[32];
+                const char* s = kind == IPV4 || kind == ERRNO ? argText(kind, v, text, sizeof(text))
+                              : (v == NULL_STRING || v >= MAX_STRINGS) ? "(null)" : r.strings + v;
+                w = snprintf(out + len, size - len, spec, s);
+            }
+            if (w > 0) len += std::min(w, size - 1 - len);
+        }
+        out[len] = '\0';
+    }
+
+    struct Repeats {
+        int64_t windowStartNs = 0;
+        int32_t printed = 0; // in the current window
+        int64_t suppressed = 0;
+        Level level = INFO;
+    };
+
+    static void print(Level level, const char* line) noexcept
+    {
+        if (level == INFO)         LogInfo("%s", line);
+        else if (level == WARNING) LogWarning("%s", line);
+        else                       LogError("%s", line);
+    }
+
+    static void printSuppressed(const char* format, const Repeats& rep) noexcept
+    {
+        // the raw format tells which message it was, without colors or arguments
+        std::string what = format;
+        for (size_t i; (i = what.find("\x1b[")) != std::string::npos; ) {
+            size_t end = what.find('m', i);
+            what.erase(i, end == std::string::npos ? std::string::npos : end - i + 1);
+        }
+        LogWarning(ORANGE("LOG suppressed %lld repeats of: %s"), (long long)rep.suppressed, what.c_str());
+    }
+
+    void flushLoop() noexcept
+    {
+        std::unordered_map<const char*, Repeats> repeats;
+        int64_t lastDropped = 0;
+        int64_t nextCheckNs = 0;
+        char line[1024];
+        while (true) {
+            uint64_t pos = dequeuePos.load(std::memory_order_relaxed);
+            Cell& cell = cells[pos & (CAPACITY - 1)];
+            bool ready = cell.sequence.load(std::memory_order_acquire) == pos + 1;
+            int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+            if (ready) {
+                const Record& r = cell.record;
+                Repeats& rep = repeats[r.format];
+                if (now - rep.windowStartNs >= 1'000'000'000) {
+                    if (rep.suppressed > 0) printSuppressed(r.format, rep);
+                    rep = Repeats{ now, 0, 0, r.level };
+                }
+                if (rep.printed < RATE_LIMIT) {
+                    ++rep.printed;
+                    formatRecord(r, line, sizeof(line));
+                    print(r.level, line);
+                } else {
+                    ++rep.suppressed;
+                }
+                cell.sequence.store(pos + CAPACITY, std::memory_order_release);
+                dequeuePos.store(pos + 1, std::memory_order_release);
+            }
+            // once a second: repeats of messages which went quiet, and ring overflows
+            if (now >= nextCheckNs || (!ready && stopping.load(std::memory_order_relaxed))) {
+                nextCheckNs = now + 1'000'000'000;
+                for (auto& [fmt, rep] : repeats) {
+                    if (rep.suppressed > 0 && now - rep.windowStartNs >= 1'000'000'000) {
+                        printSuppressed(fmt, rep);
+                        rep.suppressed = 0;
+                    }
+                }
+                int64_t d = dropped.load(std::memory_order_relaxed);
+                if (d != lastDropped) {
+                    LogWarning(ORANGE("LOG dropped %lld messages, the log ring was full"), (long long)(d - lastDropped));
+                    lastDropped = d;
+                }
+            }
+            if (!ready) {
+                if (stopping.load(std::memory_order_relaxed)) {
+                    for (auto& [fmt, rep] : repeats)
+                        if (rep.suppressed > 0) printSuppressed(fmt, rep);
+                    return;
+                }
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        }
+    }
+};
+
+// hot path logging: queued to the flusher with --async-log, printed right away without it.
+// Pass addresses as rpp::ipaddress and errors as LogErrno{errno}, not as strings, they are formatted later
+#define HotLog(level, format, ...) do { \
+    if (AsyncLog::running()) AsyncLog::instance().push(level, format __VA_OPT__(,) __VA_ARGS__); \
+    else AsyncLog::printNow(level, format __VA_OPT__(,) __VA_ARGS__); \
+} while (0)
+#define HotLogInfo(format, ...)    HotLog(AsyncLog::INFO, format __VA_OPT__(,) __VA_ARGS__)
+#define HotLogWarning(format, ...) HotLog(AsyncLog::WARNING, format __VA_OPT__(,) __VA_ARGS__)
+#define HotLogError(format, ...)   HotLog(AsyncLog::ERROR, format __VA_OPT__(,) __VA_ARGS__)
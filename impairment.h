@@ -0,0 +1,214 @@
+#pragma once
+#include "packets.h"
+#include <stdint.h>
+#include <string.h> // memcpy
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <algorithm> // std::push_heap
+
+/**
+ * Bridge network impairments, like `tc netem` but without root:
+ * random and Gilbert-Elliott loss, delay with jitter, reordering, duplication,
+ * corruption and a rate limited link with a packet queue.
+ */
+struct ImpairmentConfig
+{
+    double lossPercent = 0.0; // independent loss
+    // Gilbert-Elliott loss: good -> bad with geP, bad -> good with geR, delivered in bad with geH,
+    // the same p/r/h that the LOSS MODEL fit reports, so a run can be checked against its config
+    double geP = 0.0;
+    double geR = 0.0;
+    double geH = 0.0;
+    int64_t delayNs = 0;
+    int64_t jitterNs = 0; // uniform +-jitter around delay, more than the packet gap also reorders
+    double reorderPercent = 0.0; // these skip the delay and overtake the packets queued before them
+    double duplicatePercent = 0.0;
+    double corruptPercent = 0.0; // flips one payload bit, so the receiver counts invalid data
+    int64_t rateBytesPerSec = 0; // link rate, packets queue behind each other, 0: unlimited
+    int32_t queueLimit = 32768; // packets held at once, the rest are dropped as overflow
+    bool toServer = true;
+    bool toClient = true;
+
+    bool enabled() const noexcept
+    {
+        return lossPercent > 0 || geP > 0 || delayNs > 0 || jitterNs > 0 || reorderPercent > 0
+            || duplicatePercent > 0 || corruptPercent > 0 || rateBytesPerSec > 0;
+    }
+};
+
+/**
+ * One direction of a bridge session: impairs the packets and holds them until they are due.
+ *
+ * Packets are copied into a pool of preallocated slots and ordered by a binary min-heap of
+ * release times, so tens of thousands of packets in flight cost no allocation per packet.
+ * The pool is never zeroed, so only the slots actually used are backed by memory.
+ * Only DATA is impaired. STATUS is never lost and leaves after all the DATA queued before it,
+ * otherwise a delayed burst would arrive after its own BURST_FINISH.
+ *
+ * Only the forwarding thread of this direction calls submit/release, the counters can be read anywhere.
+ */
+struct Impairment
+{
+    struct Slot {
+        int64_t recvTimeNs; // when the bridge received it, for the forwarding latency
+        int32_t len;
+        alignas(8) char data[MAX_PACKET_SIZE];
+    };
+    struct Entry {
+        int64_t dueNs;
+        uint64_t order; // FIFO for equal release times
+        int32_t slot;
+        // std::push_heap builds a max-heap, so the earliest release time must compare as largest
+        bool operator<(const Entry& e) const noexcept {
+            return dueNs != e.dueNs ? dueNs > e.dueNs : order > e.order;
+        }
+    };
+
+    // ground truth, to compare against what the receiver reports
+    struct Counters {
+        std::atomic<int64_t> data { 0 }; // DATA packets submitted
+        std::atomic<int64_t> lost { 0 }; // random and Gilbert-Elliott
+        std::atomic<int64_t> overflow { 0 }; // dropped because the queue was full
+        std::atomic<int64_t> duplicated { 0 };
+        std::atomic<int64_t> corrupted { 0 };
+        std::atomic<int64_t> reordered { 0 };
+        void clear() noexcept { data = lost = overflow = duplicated = corrupted = reordered = 0; }
+    };
+
+    ImpairmentConfig config;
+    Counters counters;
+    std::unique_ptr<Slot[]> slots;
+    std::vector<int32_t> freeSlots;
+    std::vector<Entry> heap;
+    uint64_t nextOrder = 0;
+    int64_t lastDueNs = 0; // latest release time queued so far
+    int64_t linkFreeNs = 0; // --impair-rate: when the link finishes sending the last packet
+    bool geBad = false;
+    uint64_t rng;
+
+    Impairment(const ImpairmentConfig& cfg, uint64_t seed) noexcept
+        : config{cfg}, slots{new Slot[size_t(cfg.queueLimit)]}, rng{seed | 1}
+    {
+        freeSlots.reserve(size_t(config.queueLimit));
+        for (int32_t i = config.queueLimit - 1; i >= 0; --i)
+            freeSlots.push_back(i);
+        heap.reserve(size_t(config.queueLimit));
+    }
+
+    int32_t queued() const noexcept { return int32_t(heap.size()); }
+
+    // release time of the next packet, or INT64_MAX if none are queued
+    int64_t nextDueNs() const noexcept { return heap.empty() ? INT64_MAX : heap.front().dueNs; }
+
+    void submit(const Packet& p, int len, int64_t recvTimeNs, int64_t nowNs) noexcept
+    {
+        if (p.type != PacketType::DATA) {
+            // control packets keep their place behind the DATA sent before them
+            if (hasRoom(len)) {
+                int64_t dueNs = std::max(linkDeparture(nowNs, len) + config.delayNs, lastDueNs);
+                enqueue(p, len, recvTimeNs, dueNs, /*corrupt*/false);
+            }
+            return;
+        }
+        counters.data.fetch_add(1, std::memory_order_relaxed);
+        if (isLost()) {
+            counters.lost.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        bool reorder = config.reorderPercent > 0 && chance(config.reorderPercent);
+        bool corrupt = config.corruptPercent > 0 && chance(config.corruptPercent);
+        bool duplicate = config.duplicatePercent > 0 && chance(config.duplicatePercent);
+        for (int copy = 0; copy < (duplicate ? 2 : 1); ++copy) {
+            if (!hasRoom(len))
+                return;
+            // the link sends the copy, then it propagates for delay +- jitter,
+            // a reordered one skips the propagation delay and overtakes the packets in flight
+            int64_t dueNs = linkDeparture(nowNs, len);
+            if (!reorder) {
+                dueNs += config.delayNs;
+                if (config.jitterNs > 0)
+                    dueNs = std::max(nowNs, dueNs + int64_t((uniform() * 2.0 - 1.0) * double(config.jitterNs)));
+            }
+            if (copy == 0 && reorder) counters.reordered.fetch_add(1, std::memory_order_relaxed);
+            if (copy == 1)            counters.duplicated.fetch_add(1, std::memory_order_relaxed);
+            enqueue(p, len, recvTimeNs, dueNs, corrupt && copy == 0);
+        }
+    }
+
+    // calls send(const Packet&, int len, int64_t recvTimeNs) for every packet due by nowNs
+    template<class SendFunc>
+    void release(int64_t nowNs, SendFunc&& send) noexcept
+    {
+        while (!heap.empty() && heap.front().dueNs <= nowNs) {
+            std::pop_heap(heap.begin(), heap.end());
+            int32_t index = heap.back().slot;
+            heap.pop_back();
+            const Slot& slot = slots[index];
+            send(*reinterpret_cast<const Packet*>(slot.data), slot.len, slot.recvTimeNs);
+            freeSlots.push_back(index);
+        }
+    }
+
+private:
+    bool hasRoom(int len) noexcept
+    {
+        if (!freeSlots.empty() && len <= MAX_PACKET_SIZE)
+            return true;
+        counters.overflow.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    // --impair-rate: the packet waits for the link, then occupies it for its serialization time
+    int64_t linkDeparture(int64_t nowNs, int len) noexcept
+    {
+        if (config.rateBytesPerSec <= 0)
+            return nowNs;
+        int64_t startNs = std::max(nowNs, linkFreeNs);
+        linkFreeNs = startNs + int64_t(len) * 1'000'000'000 / config.rateBytesPerSec;
+        return linkFreeNs;
+    }
+
+    void enqueue(const Packet& p, int len, int64_t recvTimeNs, int64_t dueNs, bool corrupt) noexcept
+    {
+        int32_t index = freeSlots.back();
+        freeSlots.pop_back();
+        Slot& slot = slots[index];
+        slot.recvTimeNs = recvTimeNs;
+        slot.len = len;
+        memcpy(slot.data, &p, size_t(len));
+        int payload = len - int(sizeof(Packet));
+        if (corrupt && payload > 0) {
+            uint64_t bit = next() % (uint64_t(payload) * 8);
+            slot.data[sizeof(Packet) + bit / 8] ^= char(1 << (bit % 8));
+            counters.corrupted.fetch_add(1, std::memory_order_relaxed);
+        }
+        lastDueNs = std::max(lastDueNs, dueNs);
+        heap.push_back({ dueNs, nextOrder++, index });
+        std::push_heap(heap.begin(), heap.end());
+    }
+
+    bool isLost() noexcept
+    {
+        bool lost = config.lossPercent > 0 && chance(config.lossPercent);
+        if (config.geP > 0) {
+            geBad = geBad ? uniform() >= config.geR : uniform() < config.geP;
+            if (geBad && uniform() >= config.geH)
+                lost = true;
+        }
+        return lost;
+    }
+
+    bool chance(double percent) noexcept { return uniform() * 100.0 < percent; }
+
+    // xorshift64*, cheap and good enough for emulating a link
+    uint64_t next() noexcept
+    {
+        rng ^= rng >> 12;
+        rng ^= rng << 25;
+        rng ^= rng >> 27;
+        return rng * 0x2545F4914F6CDD1Dull;
+    }
+
+    double uniform() noexcept { return double(next() >> 11) * (1.0 / 9007199254740992.0); }
+};
@@ -0,0 +1,144 @@
+#pragma once
+#include "logging.h"
+#include "utils.h"
+#include <string.h> // memset
+
+/**
+ * Fixed-memory latency histogram with HDR-style log-linear buckets:
+ * every power of 2 is split into SUB_BUCKETS linear buckets, giving ~6% precision
+ * from nanoseconds to hours. Recording is O(1), percentiles are computed on print.
+ */
+struct LatencyHistogram
+{
+    static constexpr int SUB_BITS = 4;
+    static constexpr int SUB_BUCKETS = 1 << SUB_BITS;
+    static constexpr int NUM_BUCKETS = (64 - SUB_BITS) * SUB_BUCKETS;
+
+    uint32_t counts[NUM_BUCKETS];
+    int64_t total = 0;
+    int64_t minValue = INT64_MAX;
+    int64_t maxValue = 0;
+    int64_t clamped = 0; // negative samples recorded as 0, e.g. unsynchronized clocks
+
+    LatencyHistogram() noexcept { reset(); }
+
+    void reset() noexcept
+    {
+        memset(counts, 0, sizeof(counts));
+        total = 0;
+        minValue = INT64_MAX;
+        maxValue = 0;
+        clamped = 0;
+    }
+
+    static int bucketIndex(uint64_t value) noexcept
+    {
+        if (value < uint64_t(SUB_BUCKETS))
+            return int(value);
+        int msb = 63 - __builtin_clzll(value);
+        int shift = msb - SUB_BITS;
+        return (shift + 1) * SUB_BUCKETS + int((value >> shift) & (SUB_BUCKETS - 1));
+    }
+
+    // @return the middle of the value range covered by this bucket
+    static int64_t bucketValue(int index) noexcept
+    {
+        if (index < SUB_BUCKETS)
+            return index;
+        int shift = index / SUB_BUCKETS - 1;
+        int64_t lower = int64_t(SUB_BUCKETS + index % SUB_BUCKETS) << shift;
+        return lower + ((int64_t(1) << shift) >> 1);
+    }
+
+    void record(int64_t valueNs) noexcept
+    {
+        if (valueNs < 0) {
+            ++clamped;
+            valueNs = 0;
+        }
+        ++counts[bucketIndex(uint64_t(valueNs))];
+        ++total;
+        if (valueNs < minValue) minValue = valueNs;
+        if (valueNs > maxValue) maxValue = valueNs;
+    }
+
+    void merge(const LatencyHistogram& other) noexcept
+    {
+        for (int i = 0; i < NUM_BUCKETS; ++i)
+            counts[i] += other.counts[i];
+        total += other.total;
+        clamped += other.clamped;
+        if (other.minValue < minValue) minValue = other.minValue;
+        if (other.maxValue > maxValue) maxValue = other.maxValue;
+    }
+
+    // leaves only the samples recorded since `earlier`, a copy of this histogram taken before,
+    // min/max become bucket accurate
+    void subtract(const LatencyHistogram& earlier) noexcept
+    {
+        for (int i = 0; i < NUM_BUCKETS; ++i)
+            if (counts[i] < earlier.counts[i]) // reset since then, so everything is new
+                return;
+        total = 0;
+        minValue = INT64_MAX;
+        maxValue = 0;
+        for (int i = 0; i < NUM_BUCKETS; ++i) {
+            counts[i] -= earlier.counts[i];
+            if (counts[i] == 0) continue;
+            total += counts[i];
+            if (minValue == INT64_MAX) minValue = bucketValue(i);
+            maxValue = bucketValue(i);
+        }
+        clamped = clamped >= earlier.clamped ? clamped - earlier.clamped : clamped;
+    }
+
+    // @param percentile [0.0, 100.0]
+    int64_t percentile(double percentile) const noexcept
+    {
+        if (total == 0)
+            return 0;
+        int64_t rank = int64_t((percentile / 100.0) * double(total) + 0.5);
+        if (rank < 1) rank = 1;
+        int64_t seen = 0;
+        for (int i = 0; i < NUM_BUCKETS; ++i) {
+            seen += counts[i];
+            if (seen >= rank)
+                return std::min(bucketValue(i), maxValue);
+        }
+        return maxValue;
+    }
+
+    void print(const char* what, const char* metric = "LATENCY") const noexcept
+    {
+        if (total == 0)
+            return;
+        LogInfo("   %s %s p50:%s  p90:%s  p99:%s  p99.9:%s  max:%s  samples:%lld", what, metric,
+                toDurationLiteral(percentile(50.0)), toDurationLiteral(percentile(90.0)),
+                toDurationLiteral(percentile(99.0)), toDurationLiteral(percentile(99.9)),
+                toDurationLiteral(maxValue), (long long)total);
+        if (clamped > 0)
+            LogInfo(ORANGE("   %s %s %lld negative samples, clocks are not synchronized"), what, metric, (long long)clamped);
+    }
+};
+
+/**
+ * RFC 3550 interarrival jitter: smoothed mean deviation of the one-way transit time
+ * of consecutive packets. Clock offset between hosts cancels out.
+ */
+struct JitterEstimator
+{
+    bool started = false;
+    int64_t lastTransit = 0;
+    double jitter = 0.0; // nanoseconds
+
+    void update(int64_t transitNs) noexcept
+    {
+        if (started) {
+            int64_t d = transitNs - lastTransit;
+            if (d < 0) d = -d;
+            jitter += (double(d) - jitter) / 16.0;
+        }
+        started = true;
+        lastTransit = transitNs;
+    }
+};
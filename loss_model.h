@@ -0,0 +1,172 @@
+#pragma once
+#include "logging.h"
+#include <stdint.h>
+#include <string>
+#include <algorithm> // std::max
+#include <math.h> // sqrt
+
+/**
+ * Loss burst and gap length distributions of a received/lost packet sequence,
+ * with a Gilbert-Elliott two-state channel fit.
+ *
+ * Packets are fed in seqid order as runs, so memory is O(1) no matter how long the test runs:
+ * run lengths go into log2 buckets, and the fit only needs the counts of lost packets,
+ * of losses following a loss and of losses two packets after a loss.
+ *
+ * The fit is Gilbert's model: the good state never loses, the bad state loses with 1-h.
+ * Its 3 parameters follow exactly from those 3 statistics:
+ *   b = P(loss | previous lost), s = P(loss | lost 2 packets ago), a = P(loss)
+ *   lambda = (s - a) / (b - a) = 1 - p - r,  d = 1-h = a + (b - a)^2 / (s - a)
+ */
+struct LossModel
+{
+    static constexpr int NUM_BUCKETS = 32; // run lengths 1, 2-3, 4-7, ...
+
+    int64_t packets = 0;
+    int64_t lost = 0;
+    int64_t lostAfterLost = 0; // lost packets whose previous packet was lost
+    int64_t lostTwoAfterLost = 0; // lost packets whose packet 2 before was lost
+
+    int64_t bursts = 0; // runs of lost packets
+    int64_t gaps = 0; // runs of received packets
+    int64_t maxBurst = 0;
+    int64_t maxGap = 0;
+    int64_t burstLengths[NUM_BUCKETS] = {};
+    int64_t gapLengths[NUM_BUCKETS] = {};
+
+    bool prevLost = false; // packet i-1
+    bool prev2Lost = false; // packet i-2
+    int64_t runLength = 0; // of the current, unfinished run
+
+    void reset() noexcept { *this = LossModel{}; }
+
+    void addReceived(int64_t count) noexcept { addRun(false, count); }
+    void addLost(int64_t count) noexcept { addRun(true, count); }
+
+    // O(1) for any run length
+    void addRun(bool isLost, int64_t count) noexcept
+    {
+        if (count <= 0)
+            return;
+        if (packets > 0 && isLost != prevLost)
+            finishRun();
+        if (isLost) {
+            lost += count;
+            lostAfterLost += count - 1 + (prevLost ? 1 : 0);
+            lostTwoAfterLost += std::max<int64_t>(count - 2, 0) + (prev2Lost ? 1 : 0)
+                              + (count >= 2 && prevLost ? 1 : 0);
+        }
+        prev2Lost = count >= 2 ? isLost : prevLost;
+        prevLost = isLost;
+        runLength += count;
+        packets += count;
+    }
+
+    // records the unfinished run, the runs at both ends are cut short by the test
+    void finishRun() noexcept
+    {
+        if (runLength <= 0)
+            return;
+        if (prevLost) {
+            ++bursts;
+            ++burstLengths[bucket(runLength)];
+            maxBurst = std::max(maxBurst, runLength);
+        } else {
+            ++gaps;
+            ++gapLengths[bucket(runLength)];
+            maxGap = std::max(maxGap, runLength);
+        }
+        runLength = 0;
+    }
+
+    struct Gilbert {
+        bool valid = false;
+        double p = 0.0; // P(good -> bad)
+        double r = 0.0; // P(bad -> good)
+        double h = 0.0; // P(delivered | bad)
+    };
+
+    // Gilbert fit from the loss statistics, falls back to h=0 (the simple Gilbert model)
+    // when losses aren't clearly correlated, e.g. independent loss gives p=loss rate, r=1-p
+    Gilbert fit() const noexcept
+    {
+        Gilbert g;
+        if (lost == 0 || lost == packets)
+            return g;
+        double a = double(lost) / packets;
+        double b = double(lostAfterLost) / lost;
+        double s = double(lostTwoAfterLost) / lost;
+        // 3 standard errors, so sampling noise of random loss isn't fitted as a bad state
+        double noise = 3.0 * sqrt(std::max(b * (1.0 - b), s * (1.0 - s)) / lost);
+        if (b - a > noise && s - a > noise) {
+            double lambda = (s - a) / (b - a);
+            double d = a + (b - a) * (b - a) / (s - a);
+            double pi = a / d; // P(bad)
+            if (lambda < 1.0 && d > 0.0 && d <= 1.0 && pi < 1.0) {
+                g = { true, pi * (1.0 - lambda), (1.0 - pi) * (1.0 - lambda), 1.0 - d };
+                return g;
+            }
+        }
+        // every lost packet is in the bad state and every bad packet is lost
+        g.valid = true;
+        g.r = 1.0 - b;
+        g.p = a * g.r / (1.0 - a);
+        g.h = 0.0;
+        return g;
+    }
+
+    void print() const noexcept
+    {
+        if (packets == 0)
+            return;
+        double lossRate = double(lost) / packets;
+        double meanBurst = bursts > 0 ? double(lost) / bursts : 0.0;
+        double meanGap = gaps > 0 ? double(packets - lost) / gaps : 0.0;
+        LogInfo("   LOSS MODEL lost:%lld/%lld (%.3f%%)  bursts:%lld mean:%.2f max:%lld  gaps mean:%.1f max:%lld",
+                (long long)lost, (long long)packets, lossRate * 100.0,
+                (long long)bursts, meanBurst, (long long)maxBurst, meanGap, (long long)maxGap);
+        if (lost == 0)
+            return;
+        LogInfo("   LOSS BURST LENGTHS %s", histogram(burstLengths));
+        LogInfo("   LOSS GAP LENGTHS   %s", histogram(gapLengths));
+
+        Gilbert g = fit();
+        if (g.valid) {
+            LogInfo("   GILBERT-ELLIOTT p:%.6f (good->bad)  r:%.4f (bad->good)  h:%.4f (delivered in bad)  bad state:%.2f pkts every %.0f pkts",
+                    g.p, g.r, g.h, g.r > 0 ? 1.0 / g.r : 0.0, g.p > 0 ? 1.0 / g.p : 0.0);
+        }
+        // independent losses would give bursts of 1/(1-lossRate) on average
+        double randomBurst = 1.0 / (1.0 - lossRate);
+        if (meanBurst > randomBurst * 1.5)
+            LogInfo(ORANGE("   LOSS is bursty, mean burst %.2f pkts vs %.2f for random loss: interleave FEC or retransmit"),
+                    meanBurst, randomBurst);
+        else
+            LogInfo(CYAN("   LOSS looks random, mean burst %.2f pkts vs %.2f for random loss: FEC suits it"),
+                    meanBurst, randomBurst);
+    }
+
+private:
+
+    static int bucket(int64_t length) noexcept
+    {
+        int b = 0;
+        while (length > 1 && b < NUM_BUCKETS - 1) { length >>= 1; ++b; }
+        return b;
+    }
+
+    // "1:120 2-3:14 4-7:2", only buckets with runs
+    static std::string histogram(const int64_t (&lengths)[NUM_BUCKETS]) noexcept
+    {
+        std::string s;
+        char item[64];
+        for (int b = 0; b < NUM_BUCKETS; ++b) {
+            if (lengths[b] == 0)
+                continue;
+            long long lo = 1ll << b, hi = (1ll << (b + 1)) - 1;
+            if (lo == hi) snprintf(item, sizeof(item), "%lld:%lld ", lo, (long long)lengths[b]);
+            else          snprintf(item, sizeof(item), "%lld-%lld:%lld ", lo, hi, (long long)lengths[b]);
+            s += item;
+        }
+        return s;
+    }
+};
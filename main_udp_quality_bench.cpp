@@ -0,0 +1,480 @@
+// udp_quality_bench: end-to-end client, server and bridge in one process over loopback,
+// plus the DATA packet build and verify microbenchmarks, compared against a stored baseline
+#include "udp_quality.h"
+#include <rpp/timer.h>
+#include <atomic>
+#include <new> // std::bad_alloc, std::align_val_t
+#include <cstddef> // std::max_align_t
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <stdlib.h> // malloc, posix_memalign
+#include <fcntl.h> // open
+#include <unistd.h> // dup2
+
+// every operator new in the process, so a hot path which allocates shows up in the report
+static std::atomic<int64_t> benchAllocations { 0 };
+
+static void* benchAlloc(size_t size, size_t alignment) noexcept
+{
+    benchAllocations.fetch_add(1, std::memory_order_relaxed);
+    if (size == 0) size = 1;
+    if (alignment <= alignof(std::max_align_t))
+        return malloc(size);
+    void* p = nullptr;
+    return posix_memalign(&p, alignment, size) == 0 ? p : nullptr;
+}
+
+static void* benchAllocOrThrow(size_t size, size_t alignment)
+{
+    if (void* p = benchAlloc(size, alignment))
+        return p;
+    throw std::bad_alloc{};
+}
+
+void* operator new(size_t size) { return benchAllocOrThrow(size, 0); }
+void* operator new[](size_t size) { return benchAllocOrThrow(size, 0); }
+void* operator new(size_t size, std::align_val_t al) { return benchAllocOrThrow(size, size_t(al)); }
+void* operator new[](size_t size, std::align_val_t al) { return benchAllocOrThrow(size, size_t(al)); }
+void* operator new(size_t size, const std::nothrow_t&) noexcept { return benchAlloc(size, 0); }
+void* operator new[](size_t size, const std::nothrow_t&) noexcept { return benchAlloc(size, 0); }
+void* operator new(size_t size, std::align_val_t al, const std::nothrow_t&) noexcept { return benchAlloc(size, size_t(al)); }
+void* operator new[](size_t size, std::align_val_t al, const std::nothrow_t&) noexcept { return benchAlloc(size, size_t(al)); }
+// malloc and posix_memalign memory are both released with free
+void operator delete(void* p) noexcept { free(p); }
+void operator delete[](void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+void operator delete[](void* p, size_t) noexcept { free(p); }
+void operator delete(void* p, std::align_val_t) noexcept { free(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { free(p); }
+void operator delete(void* p, size_t, std::align_val_t) noexcept { free(p); }
+void operator delete[](void* p, size_t, std::align_val_t) noexcept { free(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept { free(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { free(p); }
+void operator delete(void* p, std::align_val_t, const std::nothrow_t&) noexcept { free(p); }
+void operator delete[](void* p, std::align_val_t, const std::nothrow_t&) noexcept { free(p); }
+
+/**
+ * One cell of the benchmark matrix: MTU x rate x mode x socket implementation.
+ * Modes: oneway CLIENT -> SERVER, echo and talkback add SERVER -> CLIENT,
+ * bridge runs oneway through an in-process bridge.
+ * The micro/build and micro/verify cases only use the MTU and don't open any sockets.
+ */
+struct LoopbackCase
+{
+    std::string name; // "echo/udpc/mtu1450/20MB", the baseline key
+    const char* mode = "oneway";
+    bool udpc = false;
+    int32_t mtu = 1450;
+    int32_t rate = 0; // 0: unlimited
+};
+
+struct LoopbackResult
+{
+    std::string name;
+    int64_t packets = 0; // DATA the client sent and received
+    double pps = 0.0; // DATA the client sent per second
+    double bytesPerSec = 0.0; // achieved client send rate
+    double cpuNsPerPacket = 0.0; // all threads of client, server and bridge
+    double allocsPerKpkt = 0.0; // operator new calls per 1000 packets, setup included
+    double lossPercent = 0.0; // CLIENT -> SERVER
+};
+
+struct LoopbackBenchOptions
+{
+    std::string baselinePath = "bench_baseline.csv";
+    bool saveBaseline = false;
+    double thresholdPercent = 10.0; // pps regression which fails the run
+    bool ci = false; // a missing baseline, or a case missing from it, also fails the run
+    int32_t burstBytes = parseSizeLiteral("4MB");
+    int32_t port = 27700; // every case uses the next ports, so a lingering socket can't interfere
+    std::string filter; // only cases whose name contains this
+    bool verbose = false; // keep the endpoints' own logs
+};
+
+static std::vector<LoopbackCase> loopbackMatrix() noexcept
+{
+    std::vector<LoopbackCase> cases;
+    for (const char* mode : { "oneway", "echo", "talkback", "bridge" })
+        for (bool udpc : { false, true })
+            for (int32_t mtu : { 1450, 4000 })
+                for (int32_t rate : { int32_t(parseSizeLiteral("20MB")), 0 }) {
+                    LoopbackCase lc { "", mode, udpc, mtu, rate };
+                    lc.name = std::string{mode} + (udpc ? "/udpc" : "/rpp") + "/mtu" + std::to_string(mtu)
+                            + "/" + (rate > 0 ? toLiteral(rate) : std::string{"max"});
+                    cases.push_back(lc);
+                }
+    for (const char* mode : { "build", "verify" })
+        for (int32_t mtu : { 1450, 4000 })
+            cases.push_back({ std::string{"micro/"} + mode + "/mtu" + std::to_string(mtu), mode, false, mtu, 0 });
+    return cases;
+}
+
+static bool isMicroCase(const LoopbackCase& lc) noexcept
+{
+    return strcmp(lc.mode, "build") == 0 || strcmp(lc.mode, "verify") == 0;
+}
+
+// sends stdout to /dev/null while the endpoints run, errors on stderr stay visible
+struct StdoutSilencer
+{
+    int saved = -1;
+    explicit StdoutSilencer(bool silence) noexcept
+    {
+        if (!silence) return;
+        fflush(stdout);
+        int devnull = ::open("/dev/null", O_WRONLY);
+        if (devnull < 0) return;
+        saved = dup(STDOUT_FILENO);
+        dup2(devnull, STDOUT_FILENO);
+        close(devnull);
+    }
+    ~StdoutSilencer() noexcept
+    {
+        if (saved < 0) return;
+        fflush(stdout);
+        dup2(saved, STDOUT_FILENO);
+        close(saved);
+    }
+};
+
+static LoopbackResult runLoopbackCase(const LoopbackCase& lc, const LoopbackBenchOptions& o, int32_t port) noexcept
+{
+    Args base;
+    base.mtu = lc.mtu;
+    base.bytesPerBurst = o.burstBytes;
+    base.count = 1;
+    base.udpc = lc.udpc;
+    base.echo = strcmp(lc.mode, "echo") == 0;
+    base.talkback = strcmp(lc.mode, "talkback") == 0 ? o.burstBytes : 0;
+    bool bridged = strcmp(lc.mode, "bridge") == 0;
+
+    char serverAddr[64], bridgeAddr[64];
+    snprintf(serverAddr, sizeof(serverAddr), "127.0.0.1:%d", port);
+    snprintf(bridgeAddr, sizeof(bridgeAddr), "127.0.0.1:%d", port + 1);
+
+    LoopbackResult r;
+    r.name = lc.name;
+    StdoutSilencer silence { !o.verbose };
+
+    Args serverArgs = base; // no --rate, the client's rate applies to echo and talkback
+    serverArgs.is_server = true;
+    serverArgs.listenerAddr = rpp::ipaddress4(port);
+    UDPQuality server { serverArgs };
+    server.open();
+    std::thread serverThread { [&server] { server.server(); } };
+
+    std::unique_ptr<UDPQuality> bridge;
+    std::thread bridgeThread;
+    if (bridged) {
+        Args bridgeArgs = base;
+        bridgeArgs.is_bridge = true;
+        bridgeArgs.listenerAddr = rpp::ipaddress4(port + 1);
+        bridgeArgs.bridgeForwardAddr = rpp::ipaddress4(rpp::strview{serverAddr});
+        bridge = std::make_unique<UDPQuality>(bridgeArgs);
+        bridge->open();
+        bridgeThread = std::thread{[b=bridge.get()] { b->bridge(); }};
+    }
+
+    Args clientArgs = base;
+    clientArgs.is_client = true;
+    clientArgs.bytesPerSec = lc.rate;
+    clientArgs.serverAddr = rpp::ipaddress4(rpp::strview{bridged ? bridgeAddr : serverAddr});
+    UDPQuality client { clientArgs };
+    client.open();
+
+    int64_t allocStart = benchAllocations.load(std::memory_order_relaxed);
+    int64_t cpuStart = processCpuNanos();
+    client.client();
+    int64_t cpuNs = processCpuNanos() - cpuStart;
+    int64_t allocs = benchAllocations.load(std::memory_order_relaxed) - allocStart;
+
+    server.stopping = true;
+    if (bridge) bridge->stopping = true;
+    serverThread.join();
+    if (bridgeThread.joinable()) bridgeThread.join();
+
+    int32_t sent = client.serverCh.sent;
+    double seconds = client.dataSendMillis / 1000.0;
+    r.packets = int64_t(sent) + client.serverCh.received;
+    r.pps = seconds > 0 ? sent / seconds : 0.0;
+    r.bytesPerSec = seconds > 0 ? client.dataBytesSent / seconds : 0.0;
+    r.cpuNsPerPacket = r.packets > 0 ? double(cpuNs) / r.packets : 0.0;
+    r.allocsPerKpkt = r.packets > 0 ? allocs * 1000.0 / r.packets : 0.0;
+    r.lossPercent = 100.0 * (sent - client.serverCh.lastStatus.dataReceived) / std::max(sent, 1);
+    return r;
+}
+
+// runs `fn(i)` in a loop for ~`seconds` and returns the number of calls per second
+template<class Func>
+static double benchmarkRate(double seconds, Func&& fn) noexcept
+{
+    int64_t iterations = 0;
+    rpp::Timer timer { rpp::Timer::AutoStart };
+    double elapsed = 0.0;
+    do {
+        // check the timer only every 1024 iterations to keep it out of the measurement
+        for (int i = 0; i < 1024; ++i, ++iterations)
+            fn(int32_t(iterations));
+        elapsed = timer.elapsed();
+    } while (elapsed < seconds);
+    return iterations / elapsed;
+}
+
+// the original byte-by-byte payload loops, the reference for the speedup
+static void legacyWriteDataSequence(char* buffer, int size) noexcept
+{
+    int srcIdx = 0;
+    for (int i = 0; i < size; ++i) {
+        buffer[i] = (char)DATA[srcIdx];
+        if (++srcIdx >= DATA_SIZE) srcIdx = 0;
+    }
+}
+
+static bool legacyCheckDataSequence(const char* buffer, int size) noexcept
+{
+    int srcIdx = 0;
+    for (int i = 0; i < size; ++i) {
+        if (uint8_t(buffer[i]) != DATA[srcIdx]) return false;
+        if (++srcIdx >= DATA_SIZE) srcIdx = 0;
+    }
+    return true;
+}
+
+// operator new calls per 1000 calls of `fn` while benchmarkRate runs it
+template<class Func>
+static double benchmarkRate(double seconds, double& allocsPerKcall, Func&& fn) noexcept
+{
+    int64_t allocStart = benchAllocations.load(std::memory_order_relaxed);
+    rpp::Timer timer { rpp::Timer::AutoStart };
+    double rate = benchmarkRate(seconds, fn);
+    double calls = rate * timer.elapsed();
+    int64_t allocs = benchAllocations.load(std::memory_order_relaxed) - allocStart;
+    allocsPerKcall = calls > 0 ? allocs * 1000.0 / calls : 0.0;
+    return rate;
+}
+
+// packets per second on one core for building a DATA packet ready for sendto
+static double microPacketBuild(int32_t mtu, double& allocsPerKpkt) noexcept
+{
+    volatile int32_t sink = 0; // prevent the compiler from eliding the packet builds
+
+    // the original send path: fresh allocation and full payload write per packet
+    double legacyPps = benchmarkRate(1.0, [&](int32_t seqid) {
+        auto buf = std::vector<uint8_t>(mtu, '\0');
+        Data* data = reinterpret_cast<Data*>(buf.data());
+        data->type = PacketType::DATA;
+        data->status = StatusType::BURST_START;
+        data->sender = EndpointType::CLIENT;
+        data->echo = 0;
+        data->seqid = seqid;
+        data->len = mtu;
+        legacyWriteDataSequence(data->buffer, data->size(mtu));
+        sink = sink + data->buffer[seqid % data->size(mtu)];
+    });
+
+    DataPacketPool pool;
+    pool.init(mtu);
+    double poolPps = benchmarkRate(1.0, allocsPerKpkt, [&](int32_t seqid) {
+        Data& data = pool.get(seqid, EndpointType::CLIENT, false);
+        sink = sink + data.buffer[seqid % data.size(mtu)];
+    });
+
+    LogInfo("   legacy: %.2f Mpps  pool: %.2f Mpps  speedup: %.1fx", legacyPps / 1e6, poolPps / 1e6,
+            poolPps / legacyPps);
+    return poolPps;
+}
+
+// DATA packets per second on one core for verifying the payload, a rotating set of seqids like a receiver
+static double microVerify(int32_t mtu, double& allocsPerKpkt) noexcept
+{
+    int payloadSize = mtu - int(sizeof(Packet));
+    std::vector<char> legacy(payloadSize);
+    legacyWriteDataSequence(legacy.data(), payloadSize);
+
+    DataPacketPool pool;
+    pool.init(mtu);
+
+    int32_t failures = 0;
+    double legacyPps = benchmarkRate(1.0, [&](int32_t) {
+        if (!legacyCheckDataSequence(legacy.data(), payloadSize)) ++failures;
+    });
+    double simdPps = benchmarkRate(1.0, allocsPerKpkt, [&](int32_t seqid) {
+        Data& data = pool.get(seqid, EndpointType::CLIENT, false);
+        if (!checkDataSequence(data.buffer, payloadSize, seqid)) ++failures;
+    });
+    if (failures > 0)
+        LogError(RED("   verify: %d unexpected verification failures"), failures);
+
+    double toGBps = payloadSize / 1e9;
+    LogInfo("   legacy: %.2f GB/s  %s: %.2f GB/s  speedup: %.1fx", legacyPps * toGBps, DATA_CHECK_IMPL,
+            simdPps * toGBps, simdPps / legacyPps);
+    return simdPps;
+}
+
+// pps, RATE and ALLOCS/kpkt are the pool path on one core, RATE counts the payload bytes
+static LoopbackResult runMicroCase(const LoopbackCase& lc) noexcept
+{
+    LoopbackResult r;
+    r.name = lc.name;
+    r.pps = strcmp(lc.mode, "build") == 0 ? microPacketBuild(lc.mtu, r.allocsPerKpkt)
+                                          : microVerify(lc.mtu, r.allocsPerKpkt);
+    r.packets = int64_t(r.pps); // the pool loop runs for 1s
+    r.bytesPerSec = r.pps * (lc.mtu - int(sizeof(Packet)));
+    r.cpuNsPerPacket = r.pps > 0 ? 1e9 / r.pps : 0.0;
+    return r;
+}
+
+static std::unordered_map<std::string, LoopbackResult> loadLoopbackBaseline(const std::string& path) noexcept
+{
+    std::unordered_map<std::string, LoopbackResult> baseline;
+    FILE* f = fopen(path.c_str(), "r");
+    if (!f) return baseline;
+    char line[512], name[256];
+    while (fgets(line, sizeof(line), f)) {
+        LoopbackResult r;
+        long long packets;
+        if (sscanf(line, "%255[^,],%lld,%lf,%lf,%lf,%lf,%lf", name, &packets, &r.pps, &r.bytesPerSec,
+                   &r.cpuNsPerPacket, &r.allocsPerKpkt, &r.lossPercent) != 7)
+            continue; // the header
+        r.name = name;
+        r.packets = packets;
+        baseline[r.name] = r;
+    }
+    fclose(f);
+    return baseline;
+}
+
+// cases which didn't run this time, because of --filter, keep their old baseline
+static bool saveLoopbackBaseline(const std::string& path, std::unordered_map<std::string, LoopbackResult> baseline,
+                                 const std::vector<LoopbackResult>& results) noexcept
+{
+    for (const LoopbackResult& r : results)
+        baseline[r.name] = r;
+    FILE* f = fopen(path.c_str(), "w");
+    if (!f) return false;
+    fprintf(f, "name,packets,pps,bytes_per_sec,cpu_ns_per_pkt,allocs_per_kpkt,loss_percent\n");
+    for (const LoopbackCase& lc : loopbackMatrix()) {
+        auto it = baseline.find(lc.name);
+        if (it == baseline.end()) continue;
+        const LoopbackResult& r = it->second;
+        fprintf(f, "%s,%lld,%.0f,%.0f,%.1f,%.3f,%.4f\n", r.name.c_str(), (long long)r.packets,
+                r.pps, r.bytesPerSec, r.cpuNsPerPacket, r.allocsPerKpkt, r.lossPercent);
+    }
+    fclose(f);
+    return true;
+}
+
+static void printLoopbackBenchHelp(int exitCode) noexcept
+{
+    printf("UDP Quality loopback benchmark: client, server and bridge in one process\n");
+    printf("Usage: ./udp_quality_bench [--baseline <file>] [--save-baseline] [--threshold <percent>] [--ci]\n");
+    printf("Options:\n");
+    printf("    --baseline <file>        Baseline results to compare against [default bench_baseline.csv]\n");
+    printf("    --save-baseline          Writes this run as the new baseline\n");
+    printf("    --threshold <percent>    Fails if any case's pps is this much below its baseline [default 10]\n");
+    printf("    --ci                     Fails if the baseline file or any case that ran is missing from it\n");
+    printf("    --size <bytes>           Burst size of every case [default 4MB]\n");
+    printf("    --port <port>            First loopback port, each case uses the next two [default 27700]\n");
+    printf("    --filter <text>          Only runs cases whose name contains text, e.g. echo/udpc or micro/\n");
+    printf("    --verbose                Keeps the client, server and bridge logs\n");
+    printf("  Baselines depend on the host, record them on the machine which runs the comparison\n");
+    exit(exitCode);
+}
+
+// @return exit code: 1 if any case regressed beyond the threshold, or with --ci had no baseline
+static int runLoopbackBench(int argc, char* argv[]) noexcept
+{
+    LoopbackBenchOptions o;
+    for (int i = 1; i < argc; ++i) {
+        rpp::strview arg = argv[i];
+        auto next_arg = [&]() -> rpp::strview {
+            if (i + 1 >= argc) printLoopbackBenchHelp(1);
+            return argv[++i];
+        };
+        if      (arg == "--baseline")      o.baselinePath = next_arg().to_string();
+        else if (arg == "--save-baseline") o.saveBaseline = true;
+        else if (arg == "--threshold")     o.thresholdPercent = next_arg().to_double();
+        else if (arg == "--ci")            o.ci = true;
+        else if (arg == "--size")          o.burstBytes = parseSizeLiteral(next_arg());
+        else if (arg == "--port")          o.port = next_arg().to_int();
+        else if (arg == "--filter")        o.filter = next_arg().to_string();
+        else if (arg == "--verbose")       o.verbose = true;
+        else if (arg == "--help")          printLoopbackBenchHelp(0);
+        else {
+            LogError("unknown argument: %s", arg);
+            printLoopbackBenchHelp(1);
+        }
+    }
+
+    auto baseline = loadLoopbackBaseline(o.baselinePath);
+    if (baseline.empty() && !o.saveBaseline) {
+        if (o.ci) {
+            LogError(RED("BENCH no baseline in %s, --ci requires one"), o.baselinePath.c_str());
+            return 1;
+        }
+        LogInfo(ORANGE("BENCH no baseline in %s, run with --save-baseline to record one"), o.baselinePath.c_str());
+    }
+
+    std::vector<LoopbackResult> results;
+    int32_t port = o.port;
+    for (const LoopbackCase& lc : loopbackMatrix()) {
+        if (!o.filter.empty() && lc.name.find(o.filter) == std::string::npos)
+            continue;
+        LogInfo(CYAN("BENCH %s"), lc.name.c_str());
+        if (isMicroCase(lc)) {
+            results.push_back(runMicroCase(lc));
+            continue;
+        }
+        results.push_back(runLoopbackCase(lc, o, port));
+        port += 2;
+    }
+
+    int regressions = 0;
+    int unbased = 0; // cases without a baseline entry
+    LogInfo("\x1b[0m===========================================================");
+    LogInfo("   %-28s %10s %10s %8s %12s %10s %11s %7s", "CASE", "PPS", "BASE PPS", "CHANGE",
+            "RATE", "CPU ns/pkt", "ALLOCS/kpkt", "LOSS");
+    for (const LoopbackResult& r : results) {
+        auto it = baseline.find(r.name);
+        if (it == baseline.end() || it->second.pps <= 0) {
+            ++unbased;
+            LogInfo("   %-28s %10.0f %10s %8s %12s %10.0f %11.2f %6.2f%%", r.name.c_str(), r.pps, "-", "-",
+                    toRateLiteral(int64_t(r.bytesPerSec)).c_str(), r.cpuNsPerPacket, r.allocsPerKpkt, r.lossPercent);
+            continue;
+        }
+        double change = 100.0 * (r.pps - it->second.pps) / it->second.pps;
+        bool regressed = change < -o.thresholdPercent;
+        regressions += regressed ? 1 : 0;
+        if (regressed)
+            LogInfo(RED("   %-28s %10.0f %10.0f %+7.1f%% %12s %10.0f %11.2f %6.2f%%  REGRESSED"), r.name.c_str(), r.pps,
+                    it->second.pps, change, toRateLiteral(int64_t(r.bytesPerSec)).c_str(), r.cpuNsPerPacket,
+                    r.allocsPerKpkt, r.lossPercent);
+        else
+            LogInfo("   %-28s %10.0f %10.0f %+7.1f%% %12s %10.0f %11.2f %6.2f%%", r.name.c_str(), r.pps,
+                    it->second.pps, change, toRateLiteral(int64_t(r.bytesPerSec)).c_str(), r.cpuNsPerPacket,
+                    r.allocsPerKpkt, r.lossPercent);
+    }
+
+    if (o.saveBaseline) {
+        if (saveLoopbackBaseline(o.baselinePath, baseline, results))
+            LogInfo(GREEN("BENCH baseline of %zu cases written to %s"), results.size(), o.baselinePath.c_str());
+        else
+            LogError(RED("BENCH failed to write %s: %s"), o.baselinePath.c_str(), strerror(errno));
+    }
+    if (o.ci && !o.saveBaseline && unbased > 0) {
+        LogError(RED("BENCH %d cases have no baseline in %s, --ci requires one"), unbased, o.baselinePath.c_str());
+        return 1;
+    }
+    if (regressions > 0) {
+        LogError(RED("BENCH %d cases regressed more than %.1f%% below %s"), regressions, o.thresholdPercent,
+                 o.baselinePath.c_str());
+        return 1;
+    }
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    return runLoopbackBench(argc, argv);
+}
@@ -0,0 +1,127 @@
+#pragma once
+#include <stdint.h>
+#include <stdio.h> // fopen
+#include <stdlib.h> // strtoll
+#include <string.h> // strtok_r
+#include <sys/stat.h> // fstat
+
+/**
+ * Host-wide drop counters of the kernel receive path, for telling apart where packets died:
+ *
+ *  - softnet dropped: the per-CPU input backlog was full (netdev_max_backlog), before any socket
+ *  - softnet squeezed: NAPI ran out of budget with packets still waiting in the NIC ring
+ *  - UDP RcvbufErrors: a socket receive buffer was full, the socket's own SO_RXQ_OVFL says if it was ours
+ *  - UDP SndbufErrors: a socket send buffer was full
+ *  - UDP InErrors: all UDP receive errors, including RcvbufErrors and checksum errors
+ *
+ * They count every socket and interface on the host, so only deltas over a quiet burst are meaningful.
+ */
+struct HostNetStats
+{
+    bool valid = false; // false if /proc/net is not available
+    int64_t udpInErrors = 0;
+    int64_t udpRcvbufErrors = 0;
+    int64_t udpSndbufErrors = 0;
+    int64_t softnetDropped = 0;
+    int64_t softnetSqueezed = 0;
+
+    HostNetStats operator-(const HostNetStats& o) const noexcept
+    {
+        HostNetStats d;
+        d.valid = valid && o.valid;
+        d.udpInErrors = udpInErrors - o.udpInErrors;
+        d.udpRcvbufErrors = udpRcvbufErrors - o.udpRcvbufErrors;
+        d.udpSndbufErrors = udpSndbufErrors - o.udpSndbufErrors;
+        d.softnetDropped = softnetDropped - o.softnetDropped;
+        d.softnetSqueezed = softnetSqueezed - o.softnetSqueezed;
+        return d;
+    }
+
+    bool hasDrops() const noexcept
+    {
+        return udpInErrors > 0 || udpRcvbufErrors > 0 || udpSndbufErrors > 0
+            || softnetDropped > 0 || softnetSqueezed > 0;
+    }
+
+    static HostNetStats read() noexcept
+    {
+        HostNetStats s;
+        s.valid = readSnmp(s) && readSoftnet(s);
+        return s;
+    }
+
+private:
+    // /proc/net/snmp has a "Udp:" line with the column names, followed by one with the values
+    static bool readSnmp(HostNetStats& s) noexcept
+    {
+        FILE* f = fopen("/proc/net/snmp", "r");
+        if (!f) return false;
+        char names[1024], values[1024];
+        bool found = false;
+        while (fgets(names, sizeof(names), f)) {
+            if (strncmp(names, "Udp: ", 5) != 0)
+                continue;
+            if (!fgets(values, sizeof(values), f))
+                break;
+            char* nameSave = nullptr;
+            char* valueSave = nullptr;
+            char* name = strtok_r(names, " \n", &nameSave);
+            char* value = strtok_r(values, " \n", &valueSave);
+            for (; name && value; name = strtok_r(nullptr, " \n", &nameSave),
+                                  value = strtok_r(nullptr, " \n", &valueSave)) {
+                if      (strcmp(name, "InErrors") == 0)     s.udpInErrors = strtoll(value, nullptr, 10);
+                else if (strcmp(name, "RcvbufErrors") == 0) s.udpRcvbufErrors = strtoll(value, nullptr, 10);
+                else if (strcmp(name, "SndbufErrors") == 0) s.udpSndbufErrors = strtoll(value, nullptr, 10);
+            }
+            found = true;
+            break;
+        }
+        fclose(f);
+        return found;
+    }
+
+    // /proc/net/softnet_stat has one line of hex counters per CPU: processed, dropped, time_squeeze, ...
+    static bool readSoftnet(HostNetStats& s) noexcept
+    {
+        FILE* f = fopen("/proc/net/softnet_stat", "r");
+        if (!f) return false;
+        char line[512];
+        unsigned int processed, dropped, squeezed;
+        while (fgets(line, sizeof(line), f)) {
+            if (sscanf(line, "%x %x %x", &processed, &dropped, &squeezed) == 3) {
+                s.softnetDropped += dropped;
+                s.softnetSqueezed += squeezed;
+            }
+        }
+        fclose(f);
+        return true;
+    }
+};
+
+/**
+ * The drops column of /proc/net/udp for one socket, the same sk_drops counter as SO_RXQ_OVFL,
+ * for sockets read with plain recvfrom, which never sees the SO_RXQ_OVFL control message.
+ * @return -1 if the socket is not listed
+ */
+static int64_t readUdpSocketDrops(int fd) noexcept
+{
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0)
+        return -1;
+    int64_t drops = -1;
+    for (const char* path : { "/proc/net/udp", "/proc/net/udp6" }) {
+        FILE* f = fopen(path, "r");
+        if (!f) continue;
+        // sl local rem st tx:rx tr:when retrnsmt uid timeout inode ref pointer drops
+        char line[512];
+        while (drops < 0 && fgets(line, sizeof(line), f)) {
+            unsigned long long inode, sockDrops;
+            if (sscanf(line, "%*s %*s %*s %*s %*s %*s %*s %*s %*s %llu %*s %*s %llu", &inode, &sockDrops) == 2
+                && inode == (unsigned long long)st.st_ino)
+                drops = int64_t(sockDrops);
+        }
+        fclose(f);
+        if (drops >= 0) break;
+    }
+    return drops;
+}
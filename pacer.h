@@ -0,0 +1,145 @@
+#pragma once
+#include "logging.h"
+#include "utils.h"
+#include "latency_histogram.h"
+#include <time.h> // clock_nanosleep
+#include <errno.h> // EINTR
+#if __x86_64__ || __i386__
+    #include <immintrin.h> // _mm_pause
+#endif
+
+/**
+ * Token bucket pacer which replaces rpp::load_balancer on the send path.
+ *
+ * Packets are scheduled on an absolute timeline: each packet moves `nextNs` forward by its
+ * wire time, so late wakeups are caught up by the following packets instead of lowering
+ * the rate. The bucket depth `burstBytes` limits how much credit can be built up while
+ * idle or late, i.e. how many bytes may leave back to back above the paced rate.
+ *
+ * Long waits sleep with clock_nanosleep, the last SPIN_NS are busy-polled,
+ * because the kernel timer slack alone is ~50us.
+ */
+struct Pacer
+{
+    static constexpr int64_t SPIN_NS = 50'000;
+
+    int32_t bytesPerSec = 0; // 0: unlimited
+    int32_t burstBytes = 0; // 0: one packet
+    double nsPerByte = 0.0;
+    int64_t nextNs = 0; // when the next packet may be sent
+
+    // pacing error statistics since the last setRate()
+    int64_t firstSendNs = 0;
+    int64_t lastSendNs = 0;
+    int64_t lastPacketBytes = 0;
+    int64_t bytesSent = 0;
+    int64_t waits = 0; // packets which had to wait for tokens
+    LatencyHistogram wakeupError; // how late we woke up vs the scheduled send time
+
+    int32_t getRate() const noexcept { return bytesPerSec; }
+
+    void setRate(int32_t rate) noexcept
+    {
+        bytesPerSec = rate > 0 ? rate : 0;
+        nsPerByte = bytesPerSec > 0 ? 1e9 / bytesPerSec : 0.0;
+        nextNs = 0;
+        resetStats();
+    }
+
+    void setBurst(int32_t bytes) noexcept { burstBytes = bytes > 0 ? bytes : 0; }
+
+    void resetStats() noexcept
+    {
+        firstSendNs = lastSendNs = 0;
+        lastPacketBytes = bytesSent = waits = 0;
+        wakeupError.reset();
+    }
+
+    static int64_t monotonicNs() noexcept
+    {
+        timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return int64_t(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+    }
+
+    // blocks until `bytes` may be sent
+    void waitToSend(int bytes) noexcept
+    {
+        if (bytesPerSec == 0)
+            return;
+
+        int64_t now = monotonicNs();
+        // credit can't grow beyond the bucket depth, the rest is lost while idle
+        int64_t maxCreditNs = int64_t(nsPerByte * (burstBytes > 0 ? burstBytes : bytes));
+        if (nextNs < now - maxCreditNs)
+            nextNs = now - maxCreditNs;
+
+        if (nextNs > now) {
+            now = sleepUntil(nextNs);
+            wakeupError.record(now - nextNs);
+            ++waits;
+        }
+        nextNs += int64_t(nsPerByte * bytes);
+
+        if (firstSendNs == 0) firstSendNs = now;
+        lastSendNs = now;
+        lastPacketBytes = bytes;
+        bytesSent += bytes;
+    }
+
+    // advances the timeline by `bytes` without waiting, for kernel SO_TXTIME pacing
+    // @return CLOCK_MONOTONIC launch time of this packet, 0 if unlimited
+    int64_t schedule(int bytes) noexcept
+    {
+        if (bytesPerSec == 0)
+            return 0;
+
+        int64_t now = monotonicNs();
+        int64_t maxCreditNs = int64_t(nsPerByte * (burstBytes > 0 ? burstBytes : bytes));
+        if (nextNs < now - maxCreditNs)
+            nextNs = now - maxCreditNs;
+
+        int64_t launchNs = nextNs > now ? nextNs : now;
+        nextNs += int64_t(nsPerByte * bytes);
+        return launchNs;
+    }
+
+    // @return time of wakeup
+    static int64_t sleepUntil(int64_t targetNs) noexcept
+    {
+        int64_t now = monotonicNs();
+        if (targetNs - now > SPIN_NS) {
+            int64_t wakeNs = targetNs - SPIN_NS;
+            timespec ts { time_t(wakeNs / 1000000000), long(wakeNs % 1000000000) };
+            while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr) == EINTR) {}
+        }
+        while ((now = monotonicNs()) < targetNs) {
+        #if __x86_64__ || __i386__
+            _mm_pause();
+        #elif __aarch64__
+            asm volatile("yield");
+        #endif
+        }
+        return now;
+    }
+
+    // rate achieved between the first and the last paced packet
+    double actualRate() const noexcept
+    {
+        // the last packet's wire time is still ahead of lastSendNs
+        int64_t elapsedNs = lastSendNs - firstSendNs + int64_t(nsPerByte * lastPacketBytes);
+        return elapsedNs > 0 ? (bytesSent * 1e9) / elapsedNs : 0.0;
+    }
+
+    void printStats() const noexcept
+    {
+        if (bytesPerSec == 0 || bytesSent == 0)
+            return;
+        double actual = actualRate();
+        double errorPercent = 100.0 * (actual - bytesPerSec) / bytesPerSec;
+        LogInfo("   PACER target:%s  actual:%s  error:%+.2f%%  burst:%s  waits:%lld",
+                toRateLiteral(bytesPerSec), toRateLiteral(int64_t(actual)), errorPercent,
+                burstBytes > 0 ? toLiteral(burstBytes) : std::string{"1 packet"}, (long long)waits);
+        wakeupError.print("PACER WAKEUP");
+    }
+};
@@ -0,0 +1,50 @@
+#pragma once
+#include "packets.h"
+#include "data_sequence.h"
+#include <vector>
+
+/**
+ * Pre-built DATA packets with their payload already written,
+ * so the send path only has to patch the header fields (sender, echo, seqid)
+ * without any allocations or payload rewrites.
+ *
+ * There is one slot per payload pattern and seqid selects slot seqid % POOL_SIZE,
+ * so get() patches a shared template in place: the returned packet is only valid
+ * until the next get(). Sends are safe because sendto/queuePacketTo copy it first.
+ */
+struct DataPacketPool
+{
+    static constexpr int POOL_SIZE = PATTERN_SEEDS;
+
+    int mtu = 0; // size of each pre-built packet
+    int stride = 0; // mtu rounded up for aligned header access on MIPS/ARM
+    std::vector<char> buffers;
+
+    bool isValidFor(int packetSize) const noexcept { return mtu == packetSize; }
+
+    void init(int packetSize) noexcept
+    {
+        mtu = packetSize;
+        stride = (packetSize + 7) & ~7;
+        buffers.assign(size_t(POOL_SIZE) * stride, '\0');
+        for (int i = 0; i < POOL_SIZE; ++i) {
+            Data* data = reinterpret_cast<Data*>(&buffers[size_t(i) * stride]);
+            data->type = PacketType::DATA;
+            data->status = StatusType::BURST_START;
+            data->len = mtu; // pkt len
+            // slot `i` only ever holds seqids where (seqid % POOL_SIZE) == i
+            writeDataSequence(data->buffer, data->size(mtu), /*seqid*/i);
+        }
+    }
+
+    // @return pre-built packet for this seqid with the header fields patched
+    Data& get(int32_t seqid, EndpointType sender, bool echo) noexcept
+    {
+        Data* data = reinterpret_cast<Data*>(&buffers[size_t(seqid & (POOL_SIZE - 1)) * stride]);
+        data->sender = sender;
+        data->echo = echo;
+        data->seqid = seqid;
+        stampDataSequence(data->buffer, data->size(mtu), seqid);
+        return *data;
+    }
+};
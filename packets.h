@@ -94,6 +94,25 @@ struct Packet
 
     // sets the MTU size for the test
     int32_t mtu = 0;
+
+    // which of the CLIENT's parallel streams this is (--streams)
+    int32_t stream = 0;
+
+    // total number of parallel CLIENT streams
+    int32_t numStreams = 1;
+
+    // INIT: SO_RCVBUF/SO_SNDBUF the SERVER should use for this test (--sweep), 0 keeps its own
+    int32_t bufSize = 0;
+
+    // INIT: seconds of a continuous --duration test, 0 for --count bursts
+    int32_t duration = 0;
+
+    // DATA: 1 if SERVER echoed this packet back, so sendTimeNs is from the CLIENT's clock
+    int32_t echoed = 0;
+
+    // DATA: sender's wall clock in nanoseconds when the packet left the rate limiter,
+    // or when its --batch/--gso send batch was handed to the kernel
+    int64_t sendTimeNs = 0;
 };
 
 // data packet with payload
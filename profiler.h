@@ -0,0 +1,232 @@
+#pragma once
+#include "logging.h"
+#include <stdint.h>
+
+#ifndef UDPQ_PROFILE
+    #define UDPQ_PROFILE 0
+#endif
+
+/**
+ * UDPQ_PROFILE=1 (cmake -DUDPQ_PROFILE=ON): per thread time spent in each hot path phase,
+ * EAGAIN counts and thread CPU time, printed with every summary as deltas since the last one.
+ *
+ * Phases are timed with rdtsc where available, each scope costs two TSC reads and two relaxed
+ * stores into the calling thread's own counters, so there is no sharing between threads.
+ * With UDPQ_PROFILE=0 every macro expands to nothing and none of this is compiled.
+ */
+enum class ProfilePhase : int {
+    POLL,    // waiting in poll() for the socket to become readable
+    RECV,    // recvfrom/recvmmsg/io_uring/AF_XDP receive
+    SEND,    // sendto/sendmmsg/io_uring/AF_XDP send
+    PACER,   // rate limiter waits
+    VERIFY,  // checkDataSequence
+    WINDOW,  // SequenceWindow seqid accounting
+    SESSION, // server session map lookups
+    LOG,     // hot path logging
+    COUNT
+};
+
+enum class ProfileCounter : int {
+    RECV_EAGAIN, // receive found nothing, e.g. nonblocking sockets
+    SEND_EAGAIN, // socket send buffer was full
+    COUNT
+};
+
+#if UDPQ_PROFILE
+#include <algorithm> // std::max
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <pthread.h>
+#include <time.h>
+#if __x86_64__ || __i386__
+    #include <x86intrin.h> // __rdtsc
+#endif
+
+struct ThreadProfile
+{
+    static constexpr int PHASES = int(ProfilePhase::COUNT);
+    static constexpr int COUNTERS = int(ProfileCounter::COUNT);
+
+    char name[32] = "thread";
+    clockid_t cpuClock = CLOCK_THREAD_CPUTIME_ID;
+    bool alive = true;
+    std::atomic<int64_t> finalCpuNs { 0 }; // set when the thread exits, its clock is gone after that
+
+    // written only by the owning thread, read by whoever prints
+    std::atomic<uint64_t> ticks[PHASES] = {};
+    std::atomic<int64_t> calls[PHASES] = {};
+    std::atomic<int64_t> counters[COUNTERS] = {};
+
+    // values at the last print, guarded by Profiler::mutex
+    uint64_t printedTicks[PHASES] = {};
+    int64_t printedCalls[PHASES] = {};
+    int64_t printedCounters[COUNTERS] = {};
+    int64_t printedCpuNs = 0;
+
+    void add(ProfilePhase phase, uint64_t elapsed) noexcept
+    {
+        int i = int(phase);
+        ticks[i].store(ticks[i].load(std::memory_order_relaxed) + elapsed, std::memory_order_relaxed);
+        calls[i].store(calls[i].load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+    void count(ProfileCounter counter) noexcept
+    {
+        int i = int(counter);
+        counters[i].store(counters[i].load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+    int64_t cpuNs() const noexcept
+    {
+        if (!alive) return finalCpuNs.load(std::memory_order_relaxed);
+        timespec ts;
+        if (clock_gettime(cpuClock, &ts) != 0) return printedCpuNs;
+        return int64_t(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+    }
+};
+
+struct Profiler
+{
+    static inline std::mutex mutex;
+    static inline std::vector<std::unique_ptr<ThreadProfile>> threads; // never shrinks, entries outlive their threads
+    static inline uint64_t startTicks = 0; // for the tick rate calibration
+    static inline int64_t startNs = 0;
+
+    static uint64_t ticks() noexcept
+    {
+    #if __x86_64__ || __i386__
+        return __rdtsc();
+    #else
+        return uint64_t(monotonicNs());
+    #endif
+    }
+
+    static int64_t monotonicNs() noexcept
+    {
+        timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return int64_t(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+    }
+
+    static ThreadProfile& current() noexcept
+    {
+        // the destructor runs at thread exit and keeps the thread's final CPU time
+        struct Registration {
+            ThreadProfile* profile;
+            Registration() noexcept : profile{add()} {}
+            ~Registration() noexcept {
+                int64_t cpu = profile->cpuNs();
+                std::lock_guard lock { mutex };
+                profile->finalCpuNs = cpu;
+                profile->alive = false;
+            }
+        };
+        thread_local Registration registration;
+        return *registration.profile;
+    }
+
+    static void nameThread(const char* name, int index = -1) noexcept
+    {
+        ThreadProfile& tp = current();
+        std::lock_guard lock { mutex };
+        if (index >= 0) snprintf(tp.name, sizeof(tp.name), "%s%d", name, index);
+        else            snprintf(tp.name, sizeof(tp.name), "%s", name);
+    }
+
+    // prints every thread which was busy since the last print
+    static void print() noexcept
+    {
+        std::lock_guard lock { mutex };
+        double ticksPerNs = double(ticks() - startTicks) / double(std::max<int64_t>(monotonicNs() - startNs, 1));
+        for (auto& profile : threads) {
+            ThreadProfile& tp = *profile;
+            int64_t cpuNs = tp.cpuNs();
+            int64_t cpuDelta = cpuNs - tp.printedCpuNs;
+            std::string phases;
+            char item[96];
+            for (int i = 0; i < ThreadProfile::PHASES; ++i) {
+                uint64_t t = tp.ticks[i].load(std::memory_order_relaxed);
+                int64_t n = tp.calls[i].load(std::memory_order_relaxed);
+                uint64_t dt = t - tp.printedTicks[i];
+                int64_t dn = n - tp.printedCalls[i];
+                tp.printedTicks[i] = t;
+                tp.printedCalls[i] = n;
+                if (dn == 0) continue;
+                double ns = dt / ticksPerNs;
+                snprintf(item, sizeof(item), " %s:%.2fms/%lld (%.0fns)", phaseName(ProfilePhase(i)),
+                         ns / 1e6, (long long)dn, ns / dn);
+                phases += item;
+            }
+            int64_t eagain[ThreadProfile::COUNTERS];
+            for (int i = 0; i < ThreadProfile::COUNTERS; ++i) {
+                int64_t v = tp.counters[i].load(std::memory_order_relaxed);
+                eagain[i] = v - tp.printedCounters[i];
+                tp.printedCounters[i] = v;
+            }
+            tp.printedCpuNs = cpuNs;
+            if (phases.empty() && cpuDelta < 1'000'000)
+                continue; // idle since the last print
+            LogInfo("   PROFILE %-10s cpu:%.2fms%s  eagain recv:%lld send:%lld", tp.name, cpuDelta / 1e6, phases.c_str(),
+                    (long long)eagain[int(ProfileCounter::RECV_EAGAIN)], (long long)eagain[int(ProfileCounter::SEND_EAGAIN)]);
+        }
+    }
+
+    static const char* phaseName(ProfilePhase phase) noexcept
+    {
+        switch (phase) {
+            case ProfilePhase::POLL:    return "poll";
+            case ProfilePhase::RECV:    return "recv";
+            case ProfilePhase::SEND:    return "send";
+            case ProfilePhase::PACER:   return "pacer";
+            case ProfilePhase::VERIFY:  return "verify";
+            case ProfilePhase::WINDOW:  return "window";
+            case ProfilePhase::SESSION: return "session";
+            case ProfilePhase::LOG:     return "log";
+            default:                    return "?";
+        }
+    }
+
+private:
+    static ThreadProfile* add() noexcept
+    {
+        auto profile = std::make_unique<ThreadProfile>();
+        pthread_getcpuclockid(pthread_self(), &profile->cpuClock);
+        std::lock_guard lock { mutex };
+        if (threads.empty()) {
+            startTicks = ticks();
+            startNs = monotonicNs();
+        }
+        snprintf(profile->name, sizeof(profile->name), "thread%zu", threads.size());
+        profile->printedCpuNs = profile->cpuNs();
+        threads.push_back(std::move(profile));
+        return threads.back().get();
+    }
+};
+
+struct ProfileScope
+{
+    ThreadProfile& profile;
+    ProfilePhase phase;
+    uint64_t start;
+    explicit ProfileScope(ProfilePhase p) noexcept : profile{Profiler::current()}, phase{p}, start{Profiler::ticks()} {}
+    ~ProfileScope() noexcept { profile.add(phase, Profiler::ticks() - start); }
+};
+
+#define PROFILE_CONCAT2(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT2(a, b)
+#define PROFILE_SCOPE(phase) ProfileScope PROFILE_CONCAT(_profileScope, __LINE__) { ProfilePhase::phase }
+#define PROFILE_COUNT(counter) Profiler::current().count(ProfileCounter::counter)
+#define PROFILE_THREAD(...) Profiler::nameThread(__VA_ARGS__)
+#define PROFILE_PRINT() Profiler::print()
+
+#else // UDPQ_PROFILE
+
+#define PROFILE_SCOPE(phase) do {} while (0)
+#define PROFILE_COUNT(counter) do {} while (0)
+#define PROFILE_THREAD(...) do {} while (0)
+#define PROFILE_PRINT() do {} while (0)
+
+#endif // UDPQ_PROFILE
@@ -0,0 +1,176 @@
+#pragma once
+#include "logging.h"
+#include <stdint.h>
+#include <stdio.h> // fopen, snprintf
+#include <string>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <chrono>
+
+/**
+ * One machine readable result, for every burst summary and every reporting interval.
+ * Counters are for the traffic this endpoint receives from its peer, except `sent` and `peerReceived`.
+ */
+struct ResultRecord
+{
+    const char* kind = "burst"; // "burst" or "interval"
+    const char* role = "server";
+    int64_t timeMs = 0; // unix time of the report
+    int32_t iteration = 0;
+    int32_t stream = 0;
+    int64_t elapsedMs = 0; // interval length, or burst arrival time
+    int64_t sent = 0; // DATA we sent to the peer
+    int64_t peerReceived = 0; // DATA the peer got from us, from its last STATUS
+    int64_t expected = 0; // DATA the peer sent to us
+    int64_t received = 0;
+    int64_t lost = 0;
+    double lossPercent = 0.0;
+    int64_t reordered = 0;
+    int64_t duplicates = 0;
+    int64_t corrupted = 0;
+    double bytesPerSec = 0.0; // received
+    double packetsPerSec = 0.0; // received
+    int64_t latencyP50Ns = 0; // one-way
+    int64_t latencyP90Ns = 0;
+    int64_t latencyP99Ns = 0;
+    int64_t latencyP999Ns = 0;
+    int64_t latencyMaxNs = 0;
+    int64_t rttP50Ns = 0;
+    int64_t rttP99Ns = 0;
+    int64_t rttMaxNs = 0;
+    double jitterNs = 0.0;
+    int64_t socketDrops = 0; // SO_RXQ_OVFL
+    int64_t udpRcvbufErrors = 0; // host wide
+    int64_t udpInErrors = 0;
+    int64_t softnetDropped = 0;
+
+    void setExpected(int64_t packets) noexcept
+    {
+        expected = packets;
+        lost = packets > received ? packets - received : 0;
+        lossPercent = 100.0 * lost / (packets > 0 ? packets : 1);
+    }
+};
+
+/**
+ * --output json|csv <file>: JSON lines or CSV with a header row.
+ *
+ * write() only formats the record into a memory buffer under a short lock, a flusher thread
+ * does the file I/O, so a slow disk never stalls the threads that report.
+ * If the flusher falls more than MAX_PENDING bytes behind, records are dropped and counted.
+ */
+struct ResultWriter
+{
+    enum class Format { JSON, CSV };
+    static constexpr size_t MAX_PENDING = 16 * 1024 * 1024;
+    static constexpr int FLUSH_INTERVAL_MS = 500;
+
+    Format format = Format::JSON;
+    FILE* file = nullptr;
+    std::mutex mutex;
+    std::condition_variable wakeup;
+    std::string pending; // formatted records waiting for the flusher
+    std::thread flusher;
+    bool stopping = false;
+    int64_t droppedRecords = 0;
+
+    ResultWriter() noexcept = default;
+    ResultWriter(const ResultWriter&) = delete;
+    ResultWriter& operator=(const ResultWriter&) = delete;
+    ~ResultWriter() noexcept { close(); }
+
+    bool open(Format fmt, const std::string& path) noexcept
+    {
+        format = fmt;
+        file = fopen(path.c_str(), "w");
+        if (!file)
+            return false;
+        if (format == Format::CSV) {
+            pending = "kind,role,time_ms,iteration,stream,elapsed_ms,sent,peer_received,expected,received,lost,loss_percent,"
+                      "reordered,duplicates,corrupted,bytes_per_sec,packets_per_sec,"
+                      "latency_p50_ns,latency_p90_ns,latency_p99_ns,latency_p999_ns,latency_max_ns,"
+                      "rtt_p50_ns,rtt_p99_ns,rtt_max_ns,jitter_ns,"
+                      "socket_drops,udp_rcvbuf_errors,udp_in_errors,softnet_dropped\n";
+        }
+        flusher = std::thread{[this] { flushLoop(); }};
+        return true;
+    }
+
+    void close() noexcept
+    {
+        if (!flusher.joinable())
+            return;
+        {
+            std::lock_guard lock { mutex };
+            stopping = true;
+        }
+        wakeup.notify_one();
+        flusher.join();
+        fclose(file);
+        file = nullptr;
+        if (droppedRecords > 0)
+            LogError(RED("--output dropped %lld records, the disk could not keep up"), (long long)droppedRecords);
+    }
+
+    void write(const ResultRecord& r) noexcept
+    {
+        char line[1024];
+        int len;
+        if (format == Format::JSON) {
+            len = snprintf(line, sizeof(line),
+                "{\"kind\":\"%s\",\"role\":\"%s\",\"time_ms\":%lld,\"iteration\":%d,\"stream\":%d,\"elapsed_ms\":%lld,"
+                "\"sent\":%lld,\"peer_received\":%lld,\"expected\":%lld,\"received\":%lld,\"lost\":%lld,\"loss_percent\":%.4f,"
+                "\"reordered\":%lld,\"duplicates\":%lld,\"corrupted\":%lld,\"bytes_per_sec\":%.0f,\"packets_per_sec\":%.0f,"
+                "\"latency_p50_ns\":%lld,\"latency_p90_ns\":%lld,\"latency_p99_ns\":%lld,\"latency_p999_ns\":%lld,"
+                "\"latency_max_ns\":%lld,\"rtt_p50_ns\":%lld,\"rtt_p99_ns\":%lld,\"rtt_max_ns\":%lld,\"jitter_ns\":%.0f,"
+                "\"socket_drops\":%lld,\"udp_rcvbuf_errors\":%lld,\"udp_in_errors\":%lld,\"softnet_dropped\":%lld}\n",
+                r.kind, r.role, (long long)r.timeMs, r.iteration, r.stream, (long long)r.elapsedMs,
+                (long long)r.sent, (long long)r.peerReceived, (long long)r.expected, (long long)r.received, (long long)r.lost, r.lossPercent,
+                (long long)r.reordered, (long long)r.duplicates, (long long)r.corrupted, r.bytesPerSec, r.packetsPerSec,
+                (long long)r.latencyP50Ns, (long long)r.latencyP90Ns, (long long)r.latencyP99Ns, (long long)r.latencyP999Ns,
+                (long long)r.latencyMaxNs, (long long)r.rttP50Ns, (long long)r.rttP99Ns, (long long)r.rttMaxNs, r.jitterNs,
+                (long long)r.socketDrops, (long long)r.udpRcvbufErrors, (long long)r.udpInErrors, (long long)r.softnetDropped);
+        } else {
+            len = snprintf(line, sizeof(line),
+                "%s,%s,%lld,%d,%d,%lld,%lld,%lld,%lld,%lld,%lld,%.4f,%lld,%lld,%lld,%.0f,%.0f,"
+                "%lld,%lld,%lld,%lld,%lld,%lld,%lld,%lld,%.0f,%lld,%lld,%lld,%lld\n",
+                r.kind, r.role, (long long)r.timeMs, r.iteration, r.stream, (long long)r.elapsedMs,
+                (long long)r.sent, (long long)r.peerReceived, (long long)r.expected, (long long)r.received, (long long)r.lost, r.lossPercent,
+                (long long)r.reordered, (long long)r.duplicates, (long long)r.corrupted, r.bytesPerSec, r.packetsPerSec,
+                (long long)r.latencyP50Ns, (long long)r.latencyP90Ns, (long long)r.latencyP99Ns, (long long)r.latencyP999Ns,
+                (long long)r.latencyMaxNs, (long long)r.rttP50Ns, (long long)r.rttP99Ns, (long long)r.rttMaxNs, r.jitterNs,
+                (long long)r.socketDrops, (long long)r.udpRcvbufErrors, (long long)r.udpInErrors, (long long)r.softnetDropped);
+        }
+        if (len <= 0 || len >= int(sizeof(line)))
+            return;
+
+        std::lock_guard lock { mutex };
+        if (pending.size() + size_t(len) > MAX_PENDING) {
+            ++droppedRecords;
+            return;
+        }
+        pending.append(line, size_t(len));
+    }
+
+private:
+    void flushLoop() noexcept
+    {
+        std::string writing;
+        std::unique_lock lock { mutex };
+        while (true) {
+            wakeup.wait_for(lock, std::chrono::milliseconds(FLUSH_INTERVAL_MS), [this] { return stopping; });
+            writing.swap(pending);
+            bool stop = stopping;
+            lock.unlock();
+            if (!writing.empty()) {
+                fwrite(writing.data(), 1, writing.size(), file);
+                fflush(file);
+                writing.clear();
+            }
+            if (stop)
+                return;
+            lock.lock();
+        }
+    }
+};
@@ -0,0 +1,254 @@
+#pragma once
+#include "logging.h"
+#include "utils.h"
+#include "loss_model.h"
+#include <vector>
+#include <algorithm> // std::min
+
+/**
+ * Fixed-memory duplicate, reorder and loss tracking of received seqids.
+ *
+ * The last `capacity` seqids are tracked with one bit each. Seqids that slide
+ * out of the window without being received are counted as missing and summarized
+ * as run-length segments, so memory stays bounded no matter how long the test runs.
+ */
+struct SequenceWindow
+{
+    static constexpr int32_t DEFAULT_CAPACITY = 65536; // 8KB of bits
+    static constexpr int MAX_STORED_RUNS = 64; // only the first runs are listed in detail
+
+    enum Result { NEW, REORDERED, DUPLICATE, LATE };
+
+    struct Missing { int32_t count, first, last; };
+
+    int32_t capacity = DEFAULT_CAPACITY; // power of 2
+    // if only every Nth seqid arrives here (server shards), track seqid/idStride
+    int32_t idStride = 1;
+    int32_t idOffset = 0; // seqid % idStride of the seqids arriving here
+    std::vector<uint64_t> bits;
+    bool started = false;
+    int32_t base = 0; // oldest seqid still inside the window
+    int32_t highest = 0; // highest seqid received so far
+
+    int32_t reordered = 0; // new seqids which arrived after a higher seqid
+    int32_t duplicates = 0; // seqids received more than once
+    int32_t late = 0; // seqids older than the window, can't tell if duplicate
+
+    int32_t missingTotal = 0; // seqids that left the window without being received
+    int32_t missingRuns = 0; // number of missing segments, including unstored ones
+    int32_t lastMissing = 0; // last seqid of the most recent missing segment
+    std::vector<Missing> runs; // first MAX_STORED_RUNS missing segments
+    LossModel lossModel; // received/missing runs which left the window
+
+    void setCapacity(int32_t packets) noexcept
+    {
+        int32_t pow2 = 64;
+        while (pow2 < packets && pow2 < (1 << 30)) pow2 <<= 1;
+        capacity = pow2;
+        reset();
+    }
+
+    void reset() noexcept
+    {
+        bits.assign(size_t(capacity / 64), 0);
+        started = false;
+        base = highest = 0;
+        reordered = duplicates = late = 0;
+        missingTotal = missingRuns = lastMissing = 0;
+        runs.clear();
+        lossModel.reset();
+    }
+
+    void setIdMapping(int32_t stride, int32_t offset) noexcept
+    {
+        idStride = stride > 1 ? stride : 1;
+        idOffset = stride > 1 ? offset : 0;
+    }
+
+    // O(1) amortized: every seqid enters and leaves the window exactly once
+    Result accept(int32_t seqid) noexcept
+    {
+        if (idStride > 1) seqid /= idStride;
+        if (!started) {
+            if (bits.empty()) reset();
+            started = true;
+            base = highest = seqid;
+            setBit(seqid);
+            return NEW;
+        }
+
+        if (seqid > highest) {
+            int32_t newBase = seqid - capacity + 1;
+            if (newBase > base) slideTo(newBase);
+            highest = seqid;
+            setBit(seqid);
+            return NEW;
+        }
+
+        if (seqid < base) {
+            ++late;
+            return LATE;
+        }
+
+        if (testBit(seqid)) {
+            ++duplicates;
+            return DUPLICATE;
+        }
+        setBit(seqid);
+        ++reordered;
+        return REORDERED;
+    }
+
+    // missing seqids, including holes which are still inside the window
+    int32_t totalMissing() const noexcept
+    {
+        int32_t total = missingTotal;
+        forEachHole([&](int32_t, int32_t count) { total += count; });
+        return total;
+    }
+
+    // @param expectedCount if >0, seqids [0, expectedCount) were sent,
+    //                      so anything after the highest received seqid is also missing
+    void printErrors(int32_t expectedCount = 0) const noexcept
+    {
+        if (!started)
+            return;
+
+        // stored runs which left the window, followed by holes still inside it
+        std::vector<Missing> missing = runs;
+        int32_t totalMissing = missingTotal;
+        int32_t numSegments = missingRuns;
+        forEachHole([&](int32_t first, int32_t count) {
+            totalMissing += count;
+            if (missingRuns > 0 && first == lastMissing + 1 && missing.size() == size_t(missingRuns)) {
+                missing.back().count += count; // hole continues the run that already left the window
+                missing.back().last += count;
+                return;
+            }
+            ++numSegments;
+            if (missing.size() < size_t(MAX_STORED_RUNS))
+                missing.push_back({ count, first, first + count - 1 });
+        });
+
+        // the tail which never arrived, in local ids if this only sees every Nth seqid
+        int32_t lastExpected = expectedCount > idOffset ? (expectedCount - 1 - idOffset) / idStride : -1;
+        if (lastExpected > highest) {
+            int32_t count = lastExpected - highest;
+            totalMissing += count;
+            ++numSegments;
+            if (missing.size() < size_t(MAX_STORED_RUNS))
+                missing.push_back({ count, highest + 1, lastExpected });
+        }
+
+        if (numSegments > 0)
+        {
+            LogInfo(ORANGE("WARNING: Missing total:%d  segments:%d"), totalMissing, numSegments);
+            int numListed = (int)missing.size();
+            if (numListed > 20)
+            {
+                LogInfo(CYAN("WARNING: Too many missing segments to list, printing first 20"));
+                numListed = 20;
+            }
+            for (int i = 0; i < numListed; ++i)
+            {
+                const Missing& m = missing[i];
+                if (m.count == 1)      LogInfo(ORANGE("WARNING: Missing 1 seqid %d"), toSeqId(m.first));
+                else if (idStride > 1) LogInfo(ORANGE("WARNING: Missing %d seqid %d .. %d step %d"),
+                                               m.count, toSeqId(m.first), toSeqId(m.last), idStride);
+                else                   LogInfo(ORANGE("WARNING: Missing %d seqid %d .. %d"), m.count, m.first, m.last);
+            }
+        }
+        if (duplicates > 0 || reordered > 0 || late > 0)
+            LogInfo(ORANGE("WARNING: Reordered:%d  Duplicates:%d  Late:%d (older than window %d)"),
+                    reordered, duplicates, late, capacity);
+    }
+
+    // burst/gap distributions and Gilbert-Elliott fit of the whole sequence,
+    // only meaningful if this sees every seqid (not steered shards)
+    // @param expectedCount if >0, seqids [0, expectedCount) were sent
+    void printLossModel(int32_t expectedCount = 0) const noexcept
+    {
+        if (!started || idStride > 1)
+            return;
+        // the window still holds the newest seqids, add them to a copy
+        LossModel model = lossModel;
+        int32_t nextId = base;
+        forEachHole([&](int32_t first, int32_t count) {
+            model.addReceived(first - nextId);
+            model.addLost(count);
+            nextId = first + count;
+        });
+        model.addReceived(highest + 1 - nextId);
+        if (expectedCount - 1 > highest)
+            model.addLost(expectedCount - 1 - highest);
+        model.finishRun();
+        model.print();
+    }
+
+private:
+
+    int32_t toSeqId(int32_t id) const noexcept { return id * idStride + idOffset; }
+    int bitIndex(int32_t seqid) const noexcept { return seqid & (capacity - 1); }
+    bool testBit(int32_t seqid) const noexcept { int i = bitIndex(seqid); return (bits[i >> 6] >> (i & 63)) & 1; }
+    void setBit(int32_t seqid) noexcept { int i = bitIndex(seqid); bits[i >> 6] |= (1ull << (i & 63)); }
+    void clearBit(int32_t seqid) noexcept { int i = bitIndex(seqid); bits[i >> 6] &= ~(1ull << (i & 63)); }
+
+    void addMissing(int32_t first, int32_t count) noexcept
+    {
+        // a long gap leaves the window one seqid at a time, so merge adjacent pieces
+        bool continuesLastRun = missingRuns > 0 && first == lastMissing + 1;
+        lossModel.addLost(count);
+        missingTotal += count;
+        lastMissing = first + count - 1;
+        if (continuesLastRun) {
+            if (missingRuns == (int32_t)runs.size()) {
+                runs.back().count += count;
+                runs.back().last = lastMissing;
+            }
+            return;
+        }
+        ++missingRuns;
+        if (runs.size() < size_t(MAX_STORED_RUNS))
+            runs.push_back({ count, first, lastMissing });
+    }
+
+    // moves the window start to `newBase`, everything that leaves without its bit set is missing
+    void slideTo(int32_t newBase) noexcept
+    {
+        // seqids in [base, highest] are tracked by bits, anything above highest was never seen
+        int32_t trackedEnd = std::min(newBase, highest + 1);
+        int32_t runStart = -1;
+        int32_t received = 0; // received since the last missing run, for lossModel
+        for (int32_t id = base; id < trackedEnd; ++id) {
+            if (testBit(id)) {
+                clearBit(id);
+                if (runStart >= 0) { addMissing(runStart, id - runStart); runStart = -1; }
+                ++received;
+            } else if (runStart < 0) {
+                lossModel.addReceived(received);
+                received = 0;
+                runStart = id;
+            }
+        }
+        lossModel.addReceived(received);
+        if (runStart >= 0) addMissing(runStart, trackedEnd - runStart);
+        // a jump beyond the whole window: the skipped range was never received
+        if (newBase > highest + 1) addMissing(highest + 1, newBase - (highest + 1));
+        base = newBase;
+    }
+
+    // calls fn(first, count) for every missing segment still inside the window
+    template<class Func>
+    void forEachHole(Func&& fn) const noexcept
+    {
+        int32_t runStart = -1;
+        for (int32_t id = base; id <= highest; ++id) {
+            if (testBit(id)) {
+                if (runStart >= 0) { fn(runStart, id - runStart); runStart = -1; }
+            } else if (runStart < 0) {
+                runStart = id;
+            }
+        }
+        // highest is always received, so there is no open run at the end
+    }
+};
@@ -27,6 +27,19 @@
     #include <fcntl.h>
     #include <sys/ioctl.h>
 #endif
+#if __linux__
+    #include <linux/filter.h>
+    #include <linux/net_tstamp.h>
+    #include <linux/errqueue.h>
+    #include <linux/sockios.h> // SIOCOUTQ
+    #include <netinet/udp.h>
+    #ifndef UDP_SEGMENT
+        #define UDP_SEGMENT 103
+    #endif
+    #ifndef UDP_GRO
+        #define UDP_GRO 104
+    #endif
+#endif
 
 #if _WIN32
 static WSADATA wsaInit;
@@ -90,6 +103,70 @@ void socket_set_blocking(int socket, bool is_blocking) noexcept
     #endif
 }
 
+bool socket_set_reuseport(int socket) noexcept
+{
+#if __linux__
+    int t = 1;
+    return setsockopt(socket, SOL_SOCKET, SO_REUSEPORT, (const char*)&t, sizeof(t)) == 0;
+#else
+    (void)socket;
+    return false;
+#endif
+}
+
+int socket_local_port(int socket) noexcept
+{
+    struct sockaddr_in addr;
+    socklen_t len = sizeof(addr);
+    if (getsockname(socket, (struct sockaddr*)&addr, &len) < 0)
+        return -1;
+    if (addr.sin_port == 0) {
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family      = AF_INET;
+        addr.sin_addr.s_addr = INADDR_ANY;
+        addr.sin_port        = 0;
+        len = sizeof(addr);
+        if (bind(socket, (struct sockaddr*)&addr, sizeof(addr)) < 0 ||
+            getsockname(socket, (struct sockaddr*)&addr, &len) < 0)
+            return -1;
+    }
+    return ntohs(addr.sin_port);
+}
+
+bool socket_attach_seqid_steering(int socket, int num_sockets) noexcept
+{
+#if __linux__
+    // for UDP, the program sees the datagram payload at offset 0, so this matches
+    // struct Packet: type:int8 @0, seqid:int32 @4 (little-endian hosts only)
+    struct sock_filter code[] = {
+        BPF_STMT(BPF_LD  | BPF_B   | BPF_ABS, 0),          // A = type
+        BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 1/*DATA*/, 1, 0),
+        BPF_STMT(BPF_RET | BPF_K,  0),                      // STATUS -> socket 0
+        BPF_STMT(BPF_LD  | BPF_B   | BPF_ABS, 7),          // A = seqid, assembled byte by byte
+        BPF_STMT(BPF_ALU | BPF_LSH | BPF_K, 8),
+        BPF_STMT(BPF_MISC| BPF_TAX, 0),
+        BPF_STMT(BPF_LD  | BPF_B   | BPF_ABS, 6),
+        BPF_STMT(BPF_ALU | BPF_OR  | BPF_X, 0),
+        BPF_STMT(BPF_ALU | BPF_LSH | BPF_K, 8),
+        BPF_STMT(BPF_MISC| BPF_TAX, 0),
+        BPF_STMT(BPF_LD  | BPF_B   | BPF_ABS, 5),
+        BPF_STMT(BPF_ALU | BPF_OR  | BPF_X, 0),
+        BPF_STMT(BPF_ALU | BPF_LSH | BPF_K, 8),
+        BPF_STMT(BPF_MISC| BPF_TAX, 0),
+        BPF_STMT(BPF_LD  | BPF_B   | BPF_ABS, 4),
+        BPF_STMT(BPF_ALU | BPF_OR  | BPF_X, 0),
+        BPF_STMT(BPF_ALU | BPF_MOD | BPF_K, (uint32_t)num_sockets),
+        BPF_STMT(BPF_RET | BPF_A, 0),                      // DATA -> socket seqid % N
+    };
+    struct sock_fprog prog;
+    prog.len = sizeof(code) / sizeof(code[0]);
+    prog.filter = code;
+    return setsockopt(socket, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &prog, sizeof(prog)) == 0;
+#else
+    (void)socket; (void)num_sockets;
+    return false;
+#endif
+}
 
 void socket_set_buf_size(int socket, bool rcv_buf, int buf_size) noexcept
 {
@@ -155,3 +232,359 @@ bool socket_poll_recv(int socket, int timeout_ms) noexcept
         return false; // no data available (timeout)
     return (pfd.revents & POLLIN) != 0;
 }
+
+#if __linux__
+// @return SCM_TIMESTAMPING time in nanoseconds, hardware if available, 0 if none
+static int64_t get_timestamping_ns(struct msghdr* hdr) noexcept
+{
+    for (struct cmsghdr* cm = CMSG_FIRSTHDR(hdr); cm; cm = CMSG_NXTHDR(hdr, cm)) {
+        if (cm->cmsg_level == SOL_SOCKET && cm->cmsg_type == SCM_TIMESTAMPING) {
+            struct scm_timestamping ts;
+            memcpy(&ts, CMSG_DATA(cm), sizeof(ts));
+            // ts[0] is software, ts[2] is raw hardware
+            const struct timespec& t = (ts.ts[2].tv_sec || ts.ts[2].tv_nsec) ? ts.ts[2] : ts.ts[0];
+            return int64_t(t.tv_sec) * 1000000000 + t.tv_nsec;
+        }
+    }
+    return 0;
+}
+
+// @return UDP_GRO segment size, 0 if the datagram was not coalesced
+static int get_gro_size(struct msghdr* hdr) noexcept
+{
+    for (struct cmsghdr* cm = CMSG_FIRSTHDR(hdr); cm; cm = CMSG_NXTHDR(hdr, cm)) {
+        if (cm->cmsg_level == SOL_UDP && cm->cmsg_type == UDP_GRO) {
+            int gso_size;
+            memcpy(&gso_size, CMSG_DATA(cm), sizeof(gso_size));
+            return gso_size;
+        }
+    }
+    return 0;
+}
+
+// @return SO_RXQ_OVFL drop counter, the kernel only attaches it once something was dropped
+static uint32_t get_rxq_ovfl(struct msghdr* hdr) noexcept
+{
+    for (struct cmsghdr* cm = CMSG_FIRSTHDR(hdr); cm; cm = CMSG_NXTHDR(hdr, cm)) {
+        if (cm->cmsg_level == SOL_SOCKET && cm->cmsg_type == SO_RXQ_OVFL) {
+            uint32_t drops;
+            memcpy(&drops, CMSG_DATA(cm), sizeof(drops));
+            return drops;
+        }
+    }
+    return 0;
+}
+#endif
+
+bool socket_enable_gso(int socket) noexcept
+{
+#if __linux__
+    int gso_size = 0; // per message with cmsg
+    return setsockopt(socket, SOL_UDP, UDP_SEGMENT, (const char*)&gso_size, sizeof(gso_size)) == 0;
+#else
+    (void)socket;
+    return false;
+#endif
+}
+
+bool socket_enable_gro(int socket) noexcept
+{
+#if __linux__
+    int enable = 1;
+    return setsockopt(socket, SOL_UDP, UDP_GRO, (const char*)&enable, sizeof(enable)) == 0;
+#else
+    (void)socket;
+    return false;
+#endif
+}
+
+bool socket_enable_rxq_ovfl(int socket) noexcept
+{
+#if __linux__
+    int enable = 1;
+    return setsockopt(socket, SOL_SOCKET, SO_RXQ_OVFL, (const char*)&enable, sizeof(enable)) == 0;
+#else
+    (void)socket;
+    return false;
+#endif
+}
+
+bool socket_enable_timestamping(int socket, bool hardware) noexcept
+{
+#if __linux__
+    // OPT_ID: TX timestamps carry the datagram index, OPT_TSONLY: without the payload copy
+    int flags = SOF_TIMESTAMPING_RX_SOFTWARE | SOF_TIMESTAMPING_TX_SOFTWARE
+              | SOF_TIMESTAMPING_SOFTWARE | SOF_TIMESTAMPING_OPT_ID | SOF_TIMESTAMPING_OPT_TSONLY;
+    if (hardware)
+        flags |= SOF_TIMESTAMPING_RX_HARDWARE | SOF_TIMESTAMPING_TX_HARDWARE | SOF_TIMESTAMPING_RAW_HARDWARE;
+    return setsockopt(socket, SOL_SOCKET, SO_TIMESTAMPING, (const char*)&flags, sizeof(flags)) == 0;
+#else
+    (void)socket; (void)hardware;
+    return false;
+#endif
+}
+
+int socket_read_tx_timestamps(int socket, uint32_t* ids, int64_t* timestamps_ns, int max_count) noexcept
+{
+#if __linux__
+    int count = 0;
+    while (count < max_count) {
+        alignas(struct cmsghdr) char control[512];
+        struct msghdr hdr;
+        memset(&hdr, 0, sizeof(hdr));
+        hdr.msg_control    = control;
+        hdr.msg_controllen = sizeof(control);
+        if (recvmsg(socket, &hdr, MSG_ERRQUEUE | MSG_DONTWAIT) < 0)
+            break; // EAGAIN: error queue is empty
+
+        int64_t timestamp = get_timestamping_ns(&hdr);
+        for (struct cmsghdr* cm = CMSG_FIRSTHDR(&hdr); cm; cm = CMSG_NXTHDR(&hdr, cm)) {
+            if ((cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR) ||
+                (cm->cmsg_level == SOL_IPV6 && cm->cmsg_type == IPV6_RECVERR)) {
+                struct sock_extended_err err;
+                memcpy(&err, CMSG_DATA(cm), sizeof(err));
+                if (err.ee_origin == SO_EE_ORIGIN_TIMESTAMPING && timestamp != 0) {
+                    ids[count] = err.ee_data;
+                    timestamps_ns[count] = timestamp;
+                    ++count;
+                }
+            }
+        }
+    }
+    return count;
+#else
+    (void)socket; (void)ids; (void)timestamps_ns; (void)max_count;
+    return 0;
+#endif
+}
+
+bool socket_set_max_pacing_rate(int socket, uint32_t bytes_per_sec) noexcept
+{
+#if __linux__
+    uint32_t rate = bytes_per_sec > 0 ? bytes_per_sec : ~0u; // ~0: unlimited
+    return setsockopt(socket, SOL_SOCKET, SO_MAX_PACING_RATE, (const char*)&rate, sizeof(rate)) == 0;
+#else
+    (void)socket; (void)bytes_per_sec;
+    return false;
+#endif
+}
+
+bool socket_enable_txtime(int socket) noexcept
+{
+#if __linux__ && defined(SO_TXTIME)
+    struct sock_txtime config;
+    memset(&config, 0, sizeof(config));
+    config.clockid = CLOCK_MONOTONIC; // fq expects monotonic time, etf would need CLOCK_TAI
+    return setsockopt(socket, SOL_SOCKET, SO_TXTIME, (const char*)&config, sizeof(config)) == 0;
+#else
+    (void)socket;
+    return false;
+#endif
+}
+
+int socket_get_unsent_bytes(int socket) noexcept
+{
+#if __linux__
+    int unsent = 0;
+    if (ioctl(socket, SIOCOUTQ, &unsent) != 0)
+        return -1;
+    return unsent;
+#else
+    (void)socket;
+    return -1;
+#endif
+}
+
+bool socket_set_dont_fragment(int socket, bool dont_fragment) noexcept
+{
+#if __linux__
+    // DONT: datagrams above the path MTU are fragmented, DO: they fail with EMSGSIZE
+    int mode = dont_fragment ? IP_PMTUDISC_DO : IP_PMTUDISC_DONT;
+    return setsockopt(socket, IPPROTO_IP, IP_MTU_DISCOVER, (const char*)&mode, sizeof(mode)) == 0;
+#else
+    (void)socket; (void)dont_fragment;
+    return false;
+#endif
+}
+
+int socket_probe_path_mtu(uint32_t addr, unsigned short port) noexcept
+{
+#if __linux__
+    int s = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (s < 0) return -1;
+    struct sockaddr_in to;
+    memset(&to, 0, sizeof(to));
+    to.sin_family      = AF_INET;
+    to.sin_addr.s_addr = addr;
+    to.sin_port        = htons(port);
+    // connected, so IP_MTU reports the cached path MTU of this destination
+    if (connect(s, (struct sockaddr*)&to, sizeof(to)) != 0 || !socket_set_dont_fragment(s, true)) {
+        close(s);
+        return -1;
+    }
+
+    int mtu = -1;
+    socklen_t len = sizeof(mtu);
+    static char probe[65536]; // zeroes, which the peer ignores as PacketType::UNKNOWN
+    for (int attempt = 0; attempt < 3; ++attempt) {
+        if (getsockopt(s, IPPROTO_IP, IP_MTU, &mtu, &len) != 0) {
+            mtu = -1;
+            break;
+        }
+        // a full size DF probe, routers with a smaller MTU answer with ICMP fragmentation needed,
+        // which lowers the cached path MTU for the next attempt
+        int payload = mtu - 28; // IPv4 + UDP headers
+        if (payload <= 0 || payload > int(sizeof(probe)))
+            break;
+        send(s, probe, size_t(payload), 0);
+        usleep(100'000);
+        int probed = mtu;
+        if (getsockopt(s, IPPROTO_IP, IP_MTU, &probed, &len) != 0 || probed == mtu)
+            break;
+        mtu = probed;
+    }
+    close(s);
+    return mtu;
+#else
+    (void)addr; (void)port;
+    return -1;
+#endif
+}
+
+int socket_build_send_cmsgs(const udp_msg* msg, void* control, int capacity) noexcept
+{
+#if __linux__
+    static_assert(UDP_SEND_CONTROL_SIZE >= CMSG_SPACE(sizeof(uint64_t)) + CMSG_SPACE(sizeof(uint16_t)));
+    if (capacity < UDP_SEND_CONTROL_SIZE)
+        return 0;
+    memset(control, 0, UDP_SEND_CONTROL_SIZE);
+    int controlLen = 0;
+    #ifdef SO_TXTIME
+    if (msg->txtime_ns != 0) {
+        uint64_t txtime = uint64_t(msg->txtime_ns);
+        struct cmsghdr* cm = (struct cmsghdr*)((char*)control + controlLen);
+        cm->cmsg_level = SOL_SOCKET;
+        cm->cmsg_type  = SCM_TXTIME;
+        cm->cmsg_len   = CMSG_LEN(sizeof(txtime));
+        memcpy(CMSG_DATA(cm), &txtime, sizeof(txtime));
+        controlLen += CMSG_SPACE(sizeof(txtime));
+    }
+    #endif
+    if (msg->gso_size > 0 && msg->size > msg->gso_size) {
+        uint16_t gso_size = uint16_t(msg->gso_size);
+        struct cmsghdr* cm = (struct cmsghdr*)((char*)control + controlLen);
+        cm->cmsg_level = SOL_UDP;
+        cm->cmsg_type  = UDP_SEGMENT;
+        cm->cmsg_len   = CMSG_LEN(sizeof(gso_size));
+        memcpy(CMSG_DATA(cm), &gso_size, sizeof(gso_size));
+        controlLen += CMSG_SPACE(sizeof(gso_size));
+    }
+    return controlLen;
+#else
+    (void)msg; (void)control; (void)capacity;
+    return 0;
+#endif
+}
+
+void socket_parse_recv_cmsgs(udp_msg* msg, void* control, int control_len) noexcept
+{
+#if __linux__
+    static_assert(UDP_RECV_CONTROL_SIZE >= CMSG_SPACE(sizeof(struct scm_timestamping)) + 2*CMSG_SPACE(sizeof(int)));
+    struct msghdr hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.msg_control    = control;
+    hdr.msg_controllen = control_len;
+    msg->timestamp_ns = get_timestamping_ns(&hdr);
+    msg->gso_size = get_gro_size(&hdr);
+    msg->drops = get_rxq_ovfl(&hdr);
+#else
+    (void)control; (void)control_len;
+    msg->timestamp_ns = 0;
+    msg->gso_size = 0;
+    msg->drops = 0;
+#endif
+}
+
+int socket_sendmmsg(int socket, udp_msg* msgs, int count) noexcept
+{
+#if __linux__
+    static constexpr int MAX_BATCH = 1024;
+    struct mmsghdr hdrs[MAX_BATCH];
+    struct iovec iovs[MAX_BATCH];
+    struct sockaddr_in addrs[MAX_BATCH];
+    alignas(struct cmsghdr) char controls[MAX_BATCH][UDP_SEND_CONTROL_SIZE];
+    if (count > MAX_BATCH) count = MAX_BATCH;
+
+    memset(hdrs, 0, sizeof(struct mmsghdr) * count);
+    for (int i = 0; i < count; ++i) {
+        int controlLen = socket_build_send_cmsgs(&msgs[i], controls[i], UDP_SEND_CONTROL_SIZE);
+        if (controlLen > 0) {
+            hdrs[i].msg_hdr.msg_control    = controls[i];
+            hdrs[i].msg_hdr.msg_controllen = controlLen;
+        }
+        memset(&addrs[i], 0, sizeof(addrs[i]));
+        addrs[i].sin_family      = AF_INET;
+        addrs[i].sin_addr.s_addr = msgs[i].addr;
+        addrs[i].sin_port        = htons(msgs[i].port);
+        iovs[i].iov_base = msgs[i].data;
+        iovs[i].iov_len  = msgs[i].size;
+        hdrs[i].msg_hdr.msg_name    = &addrs[i];
+        hdrs[i].msg_hdr.msg_namelen = sizeof(addrs[i]);
+        hdrs[i].msg_hdr.msg_iov     = &iovs[i];
+        hdrs[i].msg_hdr.msg_iovlen  = 1;
+    }
+    return sendmmsg(socket, hdrs, count, 0);
+#else
+    for (int i = 0; i < count; ++i) {
+        if (socket_sendto(socket, msgs[i].data, msgs[i].size, msgs[i].addr, msgs[i].port) <= 0)
+            return i > 0 ? i : -1;
+    }
+    return count;
+#endif
+}
+
+int socket_recvmmsg(int socket, udp_msg* msgs, int count) noexcept
+{
+#if __linux__
+    static constexpr int MAX_BATCH = 1024;
+    struct mmsghdr hdrs[MAX_BATCH];
+    struct iovec iovs[MAX_BATCH];
+    struct sockaddr_in addrs[MAX_BATCH];
+    if (count > MAX_BATCH) count = MAX_BATCH;
+
+    alignas(struct cmsghdr) char controls[MAX_BATCH][UDP_RECV_CONTROL_SIZE];
+
+    memset(hdrs, 0, sizeof(struct mmsghdr) * count);
+    for (int i = 0; i < count; ++i) {
+        iovs[i].iov_base = msgs[i].data;
+        iovs[i].iov_len  = msgs[i].size;
+        hdrs[i].msg_hdr.msg_name    = &addrs[i];
+        hdrs[i].msg_hdr.msg_namelen = sizeof(addrs[i]);
+        hdrs[i].msg_hdr.msg_iov     = &iovs[i];
+        hdrs[i].msg_hdr.msg_iovlen  = 1;
+        hdrs[i].msg_hdr.msg_control    = controls[i];
+        hdrs[i].msg_hdr.msg_controllen = UDP_RECV_CONTROL_SIZE;
+    }
+    // MSG_WAITFORONE: block for the first datagram, then grab whatever is already queued
+    int n = recvmmsg(socket, hdrs, count, MSG_WAITFORONE, nullptr);
+    for (int i = 0; i < n; ++i) {
+        msgs[i].len  = int(hdrs[i].msg_len);
+        msgs[i].addr = addrs[i].sin_addr.s_addr;
+        msgs[i].port = ntohs(addrs[i].sin_port);
+        msgs[i].timestamp_ns = get_timestamping_ns(&hdrs[i].msg_hdr);
+        msgs[i].gso_size = get_gro_size(&hdrs[i].msg_hdr);
+        msgs[i].drops = get_rxq_ovfl(&hdrs[i].msg_hdr);
+    }
+    return n;
+#else
+    unsigned long addr = 0;
+    int len = socket_recvfrom(socket, msgs[0].data, msgs[0].size, &addr, &msgs[0].port);
+    if (len <= 0) return len;
+    msgs[0].len  = len;
+    msgs[0].addr = uint32_t(addr);
+    msgs[0].timestamp_ns = 0;
+    msgs[0].gso_size = 0;
+    msgs[0].drops = 0;
+    return 1;
+#endif
+}
@@ -9,6 +9,19 @@ int socket_udp_listener(int socket, int local_port) noexcept;
 void socket_udp_close(int socket) noexcept;
 void socket_set_blocking(int socket, bool is_blocking) noexcept;
 
+// @return local port of the socket, an unbound socket is bound to an ephemeral port first,
+//         so the port is known before the first send, or <0 on error
+int socket_local_port(int socket) noexcept;
+
+// allows several sockets to bind the same port, must be called before bind
+bool socket_set_reuseport(int socket) noexcept;
+
+// attaches a SO_REUSEPORT steering program to the port group of this socket:
+// STATUS packets always go to the first bound socket,
+// DATA packets go to socket (seqid % num_sockets)
+// @return false if not supported, kernel will fall back to 4-tuple hashing
+bool socket_attach_seqid_steering(int socket, int num_sockets) noexcept;
+
 // so_buf: SO_RCVBUF or SO_SNDBUF
 void socket_set_buf_size(int socket, bool rcv_buf, int buf_size) noexcept;
 int socket_get_buf_size(int socket, bool rcv_buf) noexcept;
@@ -21,3 +34,83 @@ int socket_recvfrom(int socket, void* buffer, int maxsize,
 
 // @return true if data is available
 bool socket_poll_recv(int socket, int timeout_ms) noexcept;
+
+// a single datagram for batched send/recv
+struct udp_msg
+{
+    void* data;          // packet buffer
+    int size;            // SEND: packet size, RECV: buffer capacity
+    int len;             // RECV: received datagram length
+    uint32_t addr;       // SEND: destination, RECV: source address
+    unsigned short port; // SEND: destination, RECV: source port
+    int64_t timestamp_ns; // RECV: kernel RX timestamp if timestamping is enabled, else 0
+    int64_t txtime_ns; // SEND: SO_TXTIME launch time (CLOCK_MONOTONIC), 0 sends immediately
+    int gso_size;        // SEND: UDP_SEGMENT size, RECV: UDP_GRO segment size, 0 if a single datagram
+    uint32_t drops;      // RECV: SO_RXQ_OVFL datagrams dropped by the socket so far, 0 if none or not enabled
+};
+
+// max UDP payload which UDP_SEGMENT can split, and the max number of segments
+static constexpr int UDP_MAX_GSO_SIZE = 65507;
+static constexpr int UDP_MAX_GSO_SEGMENTS = 64;
+
+// capacity of the control buffers below, enough for every option we use
+static constexpr int UDP_SEND_CONTROL_SIZE = 64; // SCM_TXTIME + UDP_SEGMENT
+static constexpr int UDP_RECV_CONTROL_SIZE = 128; // SCM_TIMESTAMPING + UDP_GRO + SO_RXQ_OVFL
+
+// writes the SCM_TXTIME and UDP_SEGMENT control messages of `msg` into `control`,
+// which must be cmsghdr aligned and at least UDP_SEND_CONTROL_SIZE bytes
+// @return length of the control data, 0 if none is needed
+int socket_build_send_cmsgs(const udp_msg* msg, void* control, int capacity) noexcept;
+
+// sets udp_msg::timestamp_ns, gso_size and drops from the control data of a received datagram
+void socket_parse_recv_cmsgs(udp_msg* msg, void* control, int control_len) noexcept;
+
+// sends up to `count` datagrams, using a single sendmmsg() on linux
+// @return number of datagrams sent, or <0 on error
+int socket_sendmmsg(int socket, udp_msg* msgs, int count) noexcept;
+
+// receives up to `count` datagrams, using a single recvmmsg() on linux
+// blocks until at least one datagram is available (if socket is blocking)
+// @return number of datagrams received, or <0 on error
+int socket_recvmmsg(int socket, udp_msg* msgs, int count) noexcept;
+
+// enables SO_TIMESTAMPING software RX/TX timestamps, and hardware ones if `hardware`
+// hardware timestamps are only generated if the NIC has them enabled (hwstamp_ctl)
+// and use the NIC's PTP clock, which must be synced to the system clock (phc2sys)
+// @return false if not supported
+bool socket_enable_timestamping(int socket, bool hardware) noexcept;
+
+// reads TX timestamps from the socket error queue without blocking
+// @param ids [out] datagram index counted from when timestamping was enabled
+// @param timestamps_ns [out] CLOCK_REALTIME (or NIC clock) when the datagram left
+// @return number of timestamps read, 0 if none are queued
+int socket_read_tx_timestamps(int socket, uint32_t* ids, int64_t* timestamps_ns, int max_count) noexcept;
+
+// kernel pacing of this socket's packets, requires the fq qdisc on the egress interface
+// @param bytes_per_sec 0 removes the limit
+bool socket_set_max_pacing_rate(int socket, uint32_t bytes_per_sec) noexcept;
+
+// enables per-packet launch times with udp_msg::txtime_ns, requires the fq or etf qdisc
+bool socket_enable_txtime(int socket) noexcept;
+
+// @return bytes still queued in the kernel send path (SIOCOUTQ), or <0 on error
+int socket_get_unsent_bytes(int socket) noexcept;
+
+// IP_MTU_DISCOVER: true sets DF and fails datagrams above the path MTU with EMSGSIZE,
+// false lets the kernel fragment them
+bool socket_set_dont_fragment(int socket, bool dont_fragment) noexcept;
+
+// path MTU towards addr:port (IPv4 packet size), found by sending DF probes from a temporary socket
+// and reading back IP_MTU, which ICMP fragmentation needed messages lower along the path
+// @return path MTU, or <0 if unknown
+int socket_probe_path_mtu(uint32_t addr, unsigned short port) noexcept;
+
+// probes UDP_SEGMENT support, the segment size itself is passed with udp_msg::gso_size
+bool socket_enable_gso(int socket) noexcept;
+
+// lets the kernel coalesce received datagrams, recvmmsg then reports udp_msg::gso_size
+bool socket_enable_gro(int socket) noexcept;
+
+// recvmmsg then reports the socket's drop counter in udp_msg::drops, i.e. datagrams
+// the kernel discarded because the receive buffer was full
+bool socket_enable_rxq_ovfl(int socket) noexcept;
@@ -0,0 +1,493 @@
+#include "simple_uring.h"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <vector>
+
+#if __linux__ && __has_include(<linux/io_uring.h>)
+    #define UDP_HAS_IO_URING 1
+    #include <linux/io_uring.h>
+    #include <sys/syscall.h>
+    #include <sys/mman.h>
+    #include <sys/socket.h>
+    #include <netinet/in.h>
+    #include <unistd.h>
+    #include <signal.h> // _NSIG
+    #include <time.h>
+#endif
+
+#if UDP_HAS_IO_URING
+
+static constexpr uint64_t RECV_TAG = 1; // user_data of the multishot recvmsg
+static constexpr uint64_t SEND_TAG = 1ull << 32; // user_data of a send: SEND_TAG | slot
+static constexpr uint16_t BUFFER_GROUP = 0;
+
+struct send_slot
+{
+    struct msghdr hdr;
+    struct iovec iov;
+    struct sockaddr_in addr;
+    alignas(struct cmsghdr) char control[UDP_SEND_CONTROL_SIZE];
+};
+
+struct uring_udp
+{
+    int socket = -1;
+    int fd = -1; // io_uring instance
+
+    // submission queue
+    void* sqMap = nullptr;
+    size_t sqMapLen = 0;
+    unsigned* sqHead = nullptr;
+    unsigned* sqTail = nullptr;
+    unsigned* sqArray = nullptr;
+    unsigned sqMask = 0;
+    unsigned sqEntries = 0;
+    struct io_uring_sqe* sqes = nullptr;
+    size_t sqesLen = 0;
+    unsigned sqLocalTail = 0; // SQEs prepared but not yet published
+    unsigned toSubmit = 0;
+
+    // completion queue
+    void* cqMap = nullptr;
+    size_t cqMapLen = 0;
+    unsigned* cqHead = nullptr;
+    unsigned* cqTail = nullptr;
+    unsigned cqMask = 0;
+    struct io_uring_cqe* cqes = nullptr;
+
+    // provided receive buffers: [recvmsg_out][sockaddr_in][control][payload]
+    // the ring is indexed as a plain io_uring_buf array, because in C++ the empty struct
+    // of __DECLARE_FLEX_ARRAY takes a byte and shifts io_uring_buf_ring::bufs
+    struct io_uring_buf* bufRing = nullptr;
+    size_t bufRingLen = 0;
+    char* buffers = nullptr;
+    size_t buffersLen = 0;
+    int numBuffers = 0;
+    int bufferSize = 0;
+    uint16_t bufTail = 0;
+    struct msghdr recvHdr; // only msg_namelen and msg_controllen are used by the kernel
+    bool recvArmed = false;
+    bool recvFailed = false;
+
+    // received datagrams not yet returned to the caller, and the buffers the caller is holding
+    std::vector<udp_msg> ready;
+    std::vector<uint16_t> readyBids;
+    int readyHead = 0;
+    int readyCount = 0;
+    std::vector<uint16_t> held;
+
+    // send slots
+    int sendSize = 0;
+    std::vector<char> sendData;
+    std::vector<send_slot> slots;
+    std::vector<int> freeSlots;
+
+    int64_t syscalls = 0;
+    int64_t sendErrors = 0;
+};
+
+static int sys_io_uring_setup(unsigned entries, struct io_uring_params* p) noexcept
+{
+    return int(syscall(__NR_io_uring_setup, entries, p));
+}
+
+static int sys_io_uring_enter(int fd, unsigned to_submit, unsigned min_complete,
+                              unsigned flags, void* arg, size_t argsz) noexcept
+{
+    return int(syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, arg, argsz));
+}
+
+static int sys_io_uring_register(int fd, unsigned opcode, void* arg, unsigned nr_args) noexcept
+{
+    return int(syscall(__NR_io_uring_register, fd, opcode, arg, nr_args));
+}
+
+static unsigned round_pow2(unsigned n) noexcept
+{
+    unsigned p = 1;
+    while (p < n) p <<= 1;
+    return p;
+}
+
+// @return next free SQE, submitting the queue first if it is full
+static struct io_uring_sqe* get_sqe(uring_udp* r) noexcept
+{
+    unsigned head = __atomic_load_n(r->sqHead, __ATOMIC_ACQUIRE);
+    if (r->sqLocalTail - head >= r->sqEntries) {
+        if (uring_udp_submit(r) < 0)
+            return nullptr;
+        head = __atomic_load_n(r->sqHead, __ATOMIC_ACQUIRE);
+        if (r->sqLocalTail - head >= r->sqEntries)
+            return nullptr;
+    }
+    unsigned index = r->sqLocalTail & r->sqMask;
+    struct io_uring_sqe* sqe = &r->sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    r->sqArray[index] = index;
+    ++r->sqLocalTail;
+    ++r->toSubmit;
+    return sqe;
+}
+
+static void publish_sqes(uring_udp* r) noexcept
+{
+    __atomic_store_n(r->sqTail, r->sqLocalTail, __ATOMIC_RELEASE);
+}
+
+// hands buffer `bid` back to the kernel
+static void recycle_buffer(uring_udp* r, uint16_t bid) noexcept
+{
+    struct io_uring_buf* buf = &r->bufRing[r->bufTail & (r->numBuffers - 1)];
+    buf->addr = uint64_t(uintptr_t(r->buffers + size_t(bid) * r->bufferSize));
+    buf->len  = unsigned(r->bufferSize);
+    buf->bid  = bid;
+    ++r->bufTail;
+}
+
+static void publish_buffers(uring_udp* r) noexcept
+{
+    // the ring tail overlays the resv field of the first entry
+    __atomic_store_n(&r->bufRing[0].resv, r->bufTail, __ATOMIC_RELEASE);
+}
+
+// a multishot recvmsg keeps posting completions until it runs out of buffers or fails
+static bool arm_recv(uring_udp* r) noexcept
+{
+    struct io_uring_sqe* sqe = get_sqe(r);
+    if (!sqe) return false;
+    sqe->opcode = IORING_OP_RECVMSG;
+    sqe->fd = r->socket;
+    sqe->addr = uint64_t(uintptr_t(&r->recvHdr));
+    sqe->len = 1;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = BUFFER_GROUP;
+    sqe->user_data = RECV_TAG;
+    r->recvArmed = true;
+    return true;
+}
+
+static void on_recv_completion(uring_udp* r, const struct io_uring_cqe* cqe) noexcept
+{
+    if (!(cqe->flags & IORING_CQE_F_MORE))
+        r->recvArmed = false; // ENOBUFS or an error ended the multishot, re-armed on the next recv
+    if (cqe->res < 0) {
+        if (cqe->res == -EINVAL || cqe->res == -EOPNOTSUPP)
+            r->recvFailed = true; // kernel has no multishot recvmsg
+        return;
+    }
+    if (!(cqe->flags & IORING_CQE_F_BUFFER))
+        return;
+
+    uint16_t bid = uint16_t(cqe->flags >> IORING_CQE_BUFFER_SHIFT);
+    char* buf = r->buffers + size_t(bid) * r->bufferSize;
+    size_t headerLen = sizeof(struct io_uring_recvmsg_out) + r->recvHdr.msg_namelen + r->recvHdr.msg_controllen;
+    if (size_t(cqe->res) < headerLen) {
+        recycle_buffer(r, bid);
+        publish_buffers(r);
+        return;
+    }
+
+    struct io_uring_recvmsg_out out;
+    memcpy(&out, buf, sizeof(out));
+    char* name = buf + sizeof(out);
+    char* control = name + r->recvHdr.msg_namelen;
+    char* payload = control + r->recvHdr.msg_controllen;
+    int payloadLen = int(size_t(cqe->res) - headerLen); // less than out.payloadlen if truncated
+
+    udp_msg m;
+    memset(&m, 0, sizeof(m));
+    m.data = payload;
+    m.size = r->bufferSize - int(headerLen);
+    m.len  = payloadLen;
+    if (out.namelen >= sizeof(struct sockaddr_in)) {
+        struct sockaddr_in from;
+        memcpy(&from, name, sizeof(from));
+        m.addr = from.sin_addr.s_addr;
+        m.port = ntohs(from.sin_port);
+    }
+    socket_parse_recv_cmsgs(&m, control, int(out.controllen));
+
+    // never overflows: every ready datagram holds one of numBuffers buffers
+    int tail = (r->readyHead + r->readyCount) & (r->numBuffers - 1);
+    r->ready[tail] = m;
+    r->readyBids[tail] = bid;
+    ++r->readyCount;
+}
+
+// processes all completions: sends free their slot, received datagrams become ready
+static void reap_completions(uring_udp* r) noexcept
+{
+    unsigned head = *r->cqHead;
+    unsigned tail = __atomic_load_n(r->cqTail, __ATOMIC_ACQUIRE);
+    for (; head != tail; ++head) {
+        const struct io_uring_cqe* cqe = &r->cqes[head & r->cqMask];
+        if (cqe->user_data == RECV_TAG) {
+            on_recv_completion(r, cqe);
+        } else if (cqe->user_data & SEND_TAG) {
+            if (cqe->res < 0) ++r->sendErrors;
+            r->freeSlots.push_back(int(cqe->user_data & 0xffffffff));
+        }
+    }
+    __atomic_store_n(r->cqHead, head, __ATOMIC_RELEASE);
+}
+
+// waits for at least one completion, -1 waits forever
+// @return false on error, true on completion or timeout
+static bool wait_completions(uring_udp* r, int timeout_ms) noexcept
+{
+    publish_sqes(r);
+    unsigned toSubmit = r->toSubmit;
+    r->toSubmit = 0;
+    ++r->syscalls;
+
+    int ret;
+    if (timeout_ms < 0) {
+        ret = sys_io_uring_enter(r->fd, toSubmit, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+    } else {
+        struct __kernel_timespec ts { timeout_ms / 1000, (timeout_ms % 1000) * 1000000LL };
+        struct io_uring_getevents_arg arg;
+        memset(&arg, 0, sizeof(arg));
+        arg.sigmask_sz = _NSIG / 8;
+        arg.ts = uint64_t(uintptr_t(&ts));
+        ret = sys_io_uring_enter(r->fd, toSubmit, 1, IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &arg, sizeof(arg));
+    }
+    return ret >= 0 || errno == ETIME || errno == EINTR;
+}
+
+static void destroy(uring_udp* r) noexcept
+{
+    if (r->fd >= 0) close(r->fd); // cancels the pending recv before the buffers go away
+    if (r->sqes) munmap(r->sqes, r->sqesLen);
+    if (r->cqMap && r->cqMap != r->sqMap) munmap(r->cqMap, r->cqMapLen);
+    if (r->sqMap) munmap(r->sqMap, r->sqMapLen);
+    if (r->bufRing) munmap(r->bufRing, r->bufRingLen);
+    if (r->buffers) munmap(r->buffers, r->buffersLen);
+    delete r;
+}
+
+uring_udp* uring_udp_create(int socket, int num_buffers, int recv_size, int num_send_slots, int send_size) noexcept
+{
+    uring_udp* r = new uring_udp{};
+    r->socket = socket;
+    r->numBuffers = int(round_pow2(unsigned(num_buffers < 2 ? 2 : num_buffers > 32768 ? 32768 : num_buffers)));
+    size_t headerLen = sizeof(struct io_uring_recvmsg_out) + sizeof(struct sockaddr_in) + UDP_RECV_CONTROL_SIZE;
+    r->bufferSize = int((headerLen + recv_size + 63) & ~size_t(63));
+    if (num_send_slots < 1) num_send_slots = 1;
+
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    p.flags = IORING_SETUP_CQSIZE;
+    p.cq_entries = round_pow2(unsigned(r->numBuffers + num_send_slots + 1));
+    r->fd = sys_io_uring_setup(round_pow2(unsigned(num_send_slots + 1)), &p);
+    if (r->fd < 0 || !(p.features & IORING_FEAT_EXT_ARG)) {
+        destroy(r);
+        return nullptr;
+    }
+
+    r->sqMapLen = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    r->cqMapLen = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        r->sqMapLen = r->cqMapLen = (r->sqMapLen > r->cqMapLen ? r->sqMapLen : r->cqMapLen);
+    }
+    r->sqMap = mmap(nullptr, r->sqMapLen, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE, r->fd, IORING_OFF_SQ_RING);
+    if (r->sqMap == MAP_FAILED) { r->sqMap = nullptr; destroy(r); return nullptr; }
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        r->cqMap = r->sqMap;
+    } else {
+        r->cqMap = mmap(nullptr, r->cqMapLen, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE, r->fd, IORING_OFF_CQ_RING);
+        if (r->cqMap == MAP_FAILED) { r->cqMap = nullptr; destroy(r); return nullptr; }
+    }
+    r->sqesLen = p.sq_entries * sizeof(struct io_uring_sqe);
+    void* sqes = mmap(nullptr, r->sqesLen, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE, r->fd, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED) { destroy(r); return nullptr; }
+    r->sqes = (struct io_uring_sqe*)sqes;
+
+    char* sq = (char*)r->sqMap;
+    r->sqHead  = (unsigned*)(sq + p.sq_off.head);
+    r->sqTail  = (unsigned*)(sq + p.sq_off.tail);
+    r->sqArray = (unsigned*)(sq + p.sq_off.array);
+    r->sqMask  = *(unsigned*)(sq + p.sq_off.ring_mask);
+    r->sqEntries = p.sq_entries;
+    r->sqLocalTail = *r->sqTail;
+    char* cq = (char*)r->cqMap;
+    r->cqHead = (unsigned*)(cq + p.cq_off.head);
+    r->cqTail = (unsigned*)(cq + p.cq_off.tail);
+    r->cqMask = *(unsigned*)(cq + p.cq_off.ring_mask);
+    r->cqes   = (struct io_uring_cqe*)(cq + p.cq_off.cqes);
+
+    // provided buffer ring, must be page aligned
+    r->bufRingLen = r->numBuffers * sizeof(struct io_uring_buf);
+    void* bufRing = mmap(nullptr, r->bufRingLen, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+    r->buffersLen = size_t(r->numBuffers) * r->bufferSize;
+    void* buffers = mmap(nullptr, r->buffersLen, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+    r->bufRing = bufRing == MAP_FAILED ? nullptr : (struct io_uring_buf*)bufRing;
+    r->buffers = buffers == MAP_FAILED ? nullptr : (char*)buffers;
+    if (!r->bufRing || !r->buffers) { destroy(r); return nullptr; }
+
+    struct io_uring_buf_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = uint64_t(uintptr_t(r->bufRing));
+    reg.ring_entries = unsigned(r->numBuffers);
+    reg.bgid = BUFFER_GROUP;
+    if (sys_io_uring_register(r->fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+        destroy(r);
+        return nullptr;
+    }
+    for (int bid = 0; bid < r->numBuffers; ++bid)
+        recycle_buffer(r, uint16_t(bid));
+    publish_buffers(r);
+
+    memset(&r->recvHdr, 0, sizeof(r->recvHdr));
+    r->recvHdr.msg_namelen = sizeof(struct sockaddr_in);
+    r->recvHdr.msg_controllen = UDP_RECV_CONTROL_SIZE;
+    r->ready.resize(r->numBuffers);
+    r->readyBids.resize(r->numBuffers);
+    r->held.reserve(r->numBuffers);
+
+    r->sendSize = send_size;
+    r->sendData.resize(size_t(num_send_slots) * send_size);
+    r->slots.resize(num_send_slots);
+    r->freeSlots.reserve(num_send_slots);
+    for (int i = num_send_slots - 1; i >= 0; --i)
+        r->freeSlots.push_back(i);
+
+    if (!arm_recv(r) || uring_udp_submit(r) < 0) {
+        destroy(r);
+        return nullptr;
+    }
+    return r;
+}
+
+void uring_udp_destroy(uring_udp* ring) noexcept
+{
+    if (ring) destroy(ring);
+}
+
+bool uring_udp_queue_send(uring_udp* r, const udp_msg* msg) noexcept
+{
+    if (msg->size > r->sendSize)
+        return false;
+    while (r->freeSlots.empty()) { // every slot is in flight, wait for the kernel
+        reap_completions(r);
+        if (r->freeSlots.empty() && !wait_completions(r, -1))
+            return false;
+    }
+    int index = r->freeSlots.back();
+    struct io_uring_sqe* sqe = get_sqe(r);
+    if (!sqe) return false;
+    r->freeSlots.pop_back();
+
+    send_slot& s = r->slots[index];
+    char* data = &r->sendData[size_t(index) * r->sendSize];
+    memcpy(data, msg->data, msg->size);
+    memset(&s.hdr, 0, sizeof(s.hdr));
+    memset(&s.addr, 0, sizeof(s.addr));
+    s.addr.sin_family      = AF_INET;
+    s.addr.sin_addr.s_addr = msg->addr;
+    s.addr.sin_port        = htons(msg->port);
+    s.iov.iov_base = data;
+    s.iov.iov_len  = msg->size;
+    s.hdr.msg_name    = &s.addr;
+    s.hdr.msg_namelen = sizeof(s.addr);
+    s.hdr.msg_iov     = &s.iov;
+    s.hdr.msg_iovlen  = 1;
+    int controlLen = socket_build_send_cmsgs(msg, s.control, sizeof(s.control));
+    if (controlLen > 0) {
+        s.hdr.msg_control    = s.control;
+        s.hdr.msg_controllen = controlLen;
+    }
+
+    sqe->opcode = IORING_OP_SENDMSG;
+    sqe->fd = r->socket;
+    sqe->addr = uint64_t(uintptr_t(&s.hdr));
+    sqe->len = 1;
+    sqe->user_data = SEND_TAG | uint64_t(index);
+    return true;
+}
+
+int uring_udp_submit(uring_udp* r) noexcept
+{
+    if (r->toSubmit == 0)
+        return 0;
+    publish_sqes(r);
+    unsigned toSubmit = r->toSubmit;
+    r->toSubmit = 0;
+    ++r->syscalls;
+    return sys_io_uring_enter(r->fd, toSubmit, 0, 0, nullptr, 0);
+}
+
+int uring_udp_recv(uring_udp* r, udp_msg* msgs, int count, int timeout_ms) noexcept
+{
+    // the caller is done with the previous batch
+    if (!r->held.empty()) {
+        for (uint16_t bid : r->held)
+            recycle_buffer(r, bid);
+        publish_buffers(r);
+        r->held.clear();
+    }
+
+    int64_t deadline = 0;
+    if (timeout_ms > 0) {
+        timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        deadline = int64_t(now.tv_sec) * 1000 + now.tv_nsec / 1000000 + timeout_ms;
+    }
+
+    for (;;) {
+        reap_completions(r);
+        if (r->recvFailed) {
+            errno = EOPNOTSUPP;
+            return -1;
+        }
+        if (!r->recvArmed && !arm_recv(r))
+            return -1;
+        if (r->readyCount > 0)
+            break;
+
+        int waitMs = timeout_ms;
+        if (timeout_ms > 0) {
+            timespec now;
+            clock_gettime(CLOCK_MONOTONIC, &now);
+            int64_t remaining = deadline - (int64_t(now.tv_sec) * 1000 + now.tv_nsec / 1000000);
+            if (remaining <= 0) break;
+            waitMs = int(remaining);
+        }
+        if (timeout_ms == 0) { // non-blocking: submit whatever is queued and take a last look
+            if (uring_udp_submit(r) < 0) return -1;
+            reap_completions(r);
+            break;
+        }
+        if (!wait_completions(r, waitMs))
+            return -1;
+    }
+
+    // sends queued while there was data to return are still submitted without waiting
+    if (uring_udp_submit(r) < 0)
+        return -1;
+
+    int n = 0;
+    for (; n < count && r->readyCount > 0; ++n) {
+        msgs[n] = r->ready[r->readyHead];
+        r->held.push_back(r->readyBids[r->readyHead]);
+        r->readyHead = (r->readyHead + 1) & (r->numBuffers - 1);
+        --r->readyCount;
+    }
+    return n;
+}
+
+int64_t uring_udp_syscalls(const uring_udp* ring) noexcept { return ring->syscalls; }
+int64_t uring_udp_send_errors(const uring_udp* ring) noexcept { return ring->sendErrors; }
+
+#else // !UDP_HAS_IO_URING
+
+uring_udp* uring_udp_create(int, int, int, int, int) noexcept { return nullptr; }
+void uring_udp_destroy(uring_udp*) noexcept {}
+bool uring_udp_queue_send(uring_udp*, const udp_msg*) noexcept { return false; }
+int uring_udp_submit(uring_udp*) noexcept { return -1; }
+int uring_udp_recv(uring_udp*, udp_msg*, int, int) noexcept { return -1; }
+int64_t uring_udp_syscalls(const uring_udp*) noexcept { return 0; }
+int64_t uring_udp_send_errors(const uring_udp*) noexcept { return 0; }
+
+#endif
@@ -0,0 +1,38 @@
+#pragma once
+#include "simple_udp.h"
+
+// io_uring UDP engine on top of a simple_udp socket, using raw syscalls (no liburing)
+//
+// receive: a single multishot recvmsg keeps receiving into a ring of provided buffers,
+//          so datagrams are already in our memory when we look at the completion queue
+// send: datagrams are copied into send slots and queued as sendmsg SQEs,
+//       which are submitted in batches and complete asynchronously
+struct uring_udp;
+
+// @param num_buffers receive buffers, rounded up to a power of 2
+// @param recv_size max datagram size (or UDP_GRO super-buffer) to receive
+// @param num_send_slots max sends in flight
+// @param send_size max datagram size (or UDP_SEGMENT super-buffer) to send
+// @return nullptr if io_uring or provided buffer rings are not supported by the kernel
+uring_udp* uring_udp_create(int socket, int num_buffers, int recv_size, int num_send_slots, int send_size) noexcept;
+void uring_udp_destroy(uring_udp* ring) noexcept;
+
+// copies the datagram into a free send slot and queues it without submitting,
+// only blocks if all send slots are still in flight
+// @return false if the datagram is too big or the ring failed
+bool uring_udp_queue_send(uring_udp* ring, const udp_msg* msg) noexcept;
+
+// submits all queued sends with a single io_uring_enter, does not wait for them
+// @return number of sends submitted, or <0 on error
+int uring_udp_submit(uring_udp* ring) noexcept;
+
+// submits queued sends and waits up to `timeout_ms` (-1: forever) for received datagrams
+// msgs[i].data points into the receive buffers, which stay valid until the next uring_udp_recv()
+// @return number of datagrams received, 0 on timeout, or <0 on error
+int uring_udp_recv(uring_udp* ring, udp_msg* msgs, int count, int timeout_ms) noexcept;
+
+// io_uring_enter syscalls made so far, for syscall accounting
+int64_t uring_udp_syscalls(const uring_udp* ring) noexcept;
+
+// sends which completed with an error so far, e.g. ECONNREFUSED
+int64_t uring_udp_send_errors(const uring_udp* ring) noexcept;
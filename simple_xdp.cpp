@@ -0,0 +1,593 @@
+#include "simple_xdp.h"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <vector>
+
+#if __linux__ && __has_include(<linux/if_xdp.h>) && __has_include(<linux/bpf.h>)
+    #define UDP_HAS_AF_XDP 1
+    #include <linux/if_xdp.h>
+    #include <linux/if_link.h> // XDP_FLAGS_*
+    #include <linux/bpf.h>
+    #include <sys/syscall.h>
+    #include <sys/mman.h>
+    #include <sys/socket.h>
+    #include <sys/ioctl.h>
+    #include <net/if.h>
+    #include <net/if_arp.h>
+    #include <netinet/in.h>
+    #include <poll.h>
+    #include <unistd.h>
+    #include <time.h>
+    #ifndef AF_XDP
+        #define AF_XDP 44
+    #endif
+    #ifndef SOL_XDP
+        #define SOL_XDP 283
+    #endif
+#endif
+
+#if UDP_HAS_AF_XDP
+
+static constexpr int FRAME_SIZE = 4096;
+static constexpr int NUM_FRAMES = 8192; // 32MB of UMEM
+static constexpr int RX_FRAMES = NUM_FRAMES / 2; // the first half is for the fill/rx rings
+static constexpr int RING_SIZE = 4096; // all four rings, enough to hold all rx or all tx frames
+static constexpr int HEADERS_SIZE = 14 + 20 + 8; // ethernet + IPv4 without options + UDP
+static constexpr int MAX_NEIGHBORS = 16;
+
+// producer/consumer ring shared with the kernel, `entries` are xdp_desc or u64 frame addresses
+struct xdp_ring
+{
+    void* map = nullptr;
+    size_t mapLen = 0;
+    uint32_t* producer = nullptr;
+    uint32_t* consumer = nullptr;
+    uint32_t* flags = nullptr;
+    void* entries = nullptr;
+    uint32_t local = 0; // our producer (fill, tx) or consumer (rx, completion) position
+
+    uint64_t* addrs() const noexcept { return (uint64_t*)entries; }
+    struct xdp_desc* descs() const noexcept { return (struct xdp_desc*)entries; }
+    bool needsWakeup() const noexcept { return __atomic_load_n(flags, __ATOMIC_RELAXED) & XDP_RING_NEED_WAKEUP; }
+};
+
+struct neighbor
+{
+    uint32_t addr;
+    uint8_t mac[6];
+};
+
+struct xdp_udp
+{
+    int udpSocket = -1;
+    int xsk = -1;
+    int mapFd = -1;
+    int progFd = -1;
+    int linkFd = -1; // closing the bpf_link detaches the program
+    bool zeroCopy = false;
+    bool native = false;
+
+    char ifname[IF_NAMESIZE] = {};
+    uint8_t localMac[6] = {};
+    uint32_t localAddr = 0;
+    uint16_t localPort = 0;
+    uint16_t ipId = 0;
+
+    char* umem = nullptr;
+    size_t umemLen = 0;
+    xdp_ring fill, completion, rx, tx;
+    std::vector<uint64_t> freeTxFrames;
+    std::vector<uint64_t> held; // rx frames returned to the caller, refilled on the next recv
+    uint32_t txQueued = 0; // tx descriptors not yet published
+
+    neighbor neighbors[MAX_NEIGHBORS] = {};
+    int numNeighbors = 0;
+    int nextNeighbor = 0;
+
+    int64_t syscalls = 0;
+    int64_t kernelSends = 0;
+};
+
+static int sys_bpf(int cmd, union bpf_attr* attr) noexcept
+{
+    return int(syscall(__NR_bpf, cmd, attr, sizeof(*attr)));
+}
+
+static struct bpf_insn bpf_insn_(uint8_t code, uint8_t dst, uint8_t src, int16_t off, int32_t imm) noexcept
+{
+    struct bpf_insn insn;
+    memset(&insn, 0, sizeof(insn));
+    insn.code = code;
+    insn.dst_reg = dst;
+    insn.src_reg = src;
+    insn.off = off;
+    insn.imm = imm;
+    return insn;
+}
+
+// redirects IPv4 UDP to `port` into the AF_XDP socket of its rx queue, everything else
+// goes up the normal stack: ARP, other ports, IP options and fragments
+static int load_steering_program(int map_fd, uint16_t port) noexcept
+{
+    const int PASS = 22; // index of the XDP_PASS exit
+    auto toPass = [&](int pc) { return int16_t(PASS - (pc + 1)); };
+    struct bpf_insn code[] = {
+        /* 0*/ bpf_insn_(BPF_LDX|BPF_W|BPF_MEM,   2, 1, 0, 0),  // r2 = ctx->data
+        /* 1*/ bpf_insn_(BPF_LDX|BPF_W|BPF_MEM,   3, 1, 4, 0),  // r3 = ctx->data_end
+        /* 2*/ bpf_insn_(BPF_ALU64|BPF_MOV|BPF_X, 4, 2, 0, 0),
+        /* 3*/ bpf_insn_(BPF_ALU64|BPF_ADD|BPF_K, 4, 0, 0, HEADERS_SIZE),
+        /* 4*/ bpf_insn_(BPF_JMP|BPF_JGT|BPF_X,   4, 3, toPass(4), 0), // too short
+        /* 5*/ bpf_insn_(BPF_LDX|BPF_H|BPF_MEM,   5, 2, 12, 0), // ethertype
+        /* 6*/ bpf_insn_(BPF_JMP|BPF_JNE|BPF_K,   5, 0, toPass(6), htons(0x0800)),
+        /* 7*/ bpf_insn_(BPF_LDX|BPF_B|BPF_MEM,   5, 2, 14, 0), // IPv4, no options
+        /* 8*/ bpf_insn_(BPF_JMP|BPF_JNE|BPF_K,   5, 0, toPass(8), 0x45),
+        /* 9*/ bpf_insn_(BPF_LDX|BPF_B|BPF_MEM,   5, 2, 23, 0), // protocol
+        /*10*/ bpf_insn_(BPF_JMP|BPF_JNE|BPF_K,   5, 0, toPass(10), IPPROTO_UDP),
+        /*11*/ bpf_insn_(BPF_LDX|BPF_H|BPF_MEM,   5, 2, 20, 0), // fragment offset and MF
+        /*12*/ bpf_insn_(BPF_ALU64|BPF_AND|BPF_K, 5, 0, 0, htons(0x3fff)),
+        /*13*/ bpf_insn_(BPF_JMP|BPF_JNE|BPF_K,   5, 0, toPass(13), 0),
+        /*14*/ bpf_insn_(BPF_LDX|BPF_H|BPF_MEM,   5, 2, 36, 0), // UDP destination port
+        /*15*/ bpf_insn_(BPF_JMP|BPF_JNE|BPF_K,   5, 0, toPass(15), htons(port)),
+        /*16*/ bpf_insn_(BPF_LDX|BPF_W|BPF_MEM,   2, 1, 16, 0), // r2 = ctx->rx_queue_index
+        /*17*/ bpf_insn_(BPF_LD|BPF_DW|BPF_IMM,   1, BPF_PSEUDO_MAP_FD, 0, map_fd),
+        /*18*/ bpf_insn_(0, 0, 0, 0, 0),
+        /*19*/ bpf_insn_(BPF_ALU64|BPF_MOV|BPF_K, 3, 0, 0, XDP_PASS), // if this queue has no socket
+        /*20*/ bpf_insn_(BPF_JMP|BPF_CALL,        0, 0, 0, BPF_FUNC_redirect_map),
+        /*21*/ bpf_insn_(BPF_JMP|BPF_EXIT,        0, 0, 0, 0),
+        /*22*/ bpf_insn_(BPF_ALU64|BPF_MOV|BPF_K, 0, 0, 0, XDP_PASS),
+        /*23*/ bpf_insn_(BPF_JMP|BPF_EXIT,        0, 0, 0, 0),
+    };
+    union bpf_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.prog_type = BPF_PROG_TYPE_XDP;
+    attr.insns = uint64_t(uintptr_t(code));
+    attr.insn_cnt = sizeof(code) / sizeof(code[0]);
+    attr.license = uint64_t(uintptr_t("GPL"));
+    return sys_bpf(BPF_PROG_LOAD, &attr);
+}
+
+// @return bpf_link fd, or <0 if the program could not be attached
+static int attach_program(int prog_fd, int ifindex, uint32_t xdp_flags) noexcept
+{
+    union bpf_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.link_create.prog_fd = uint32_t(prog_fd);
+    attr.link_create.target_ifindex = uint32_t(ifindex);
+    attr.link_create.attach_type = BPF_XDP;
+    attr.link_create.flags = xdp_flags;
+    return sys_bpf(BPF_LINK_CREATE, &attr);
+}
+
+static bool map_ring(int xsk, xdp_ring& ring, const struct xdp_ring_offset& off,
+                     size_t entrySize, off_t pgoff) noexcept
+{
+    ring.mapLen = off.desc + RING_SIZE * entrySize;
+    void* map = mmap(nullptr, ring.mapLen, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE, xsk, pgoff);
+    if (map == MAP_FAILED)
+        return false;
+    ring.map = map;
+    ring.producer = (uint32_t*)((char*)map + off.producer);
+    ring.consumer = (uint32_t*)((char*)map + off.consumer);
+    ring.flags    = (uint32_t*)((char*)map + off.flags);
+    ring.entries  = (char*)map + off.desc;
+    return true;
+}
+
+static void unmap_ring(xdp_ring& ring) noexcept
+{
+    if (ring.map) munmap(ring.map, ring.mapLen);
+}
+
+static void destroy(xdp_udp* x) noexcept
+{
+    if (x->linkFd >= 0) close(x->linkFd);
+    if (x->progFd >= 0) close(x->progFd);
+    if (x->mapFd >= 0) close(x->mapFd);
+    unmap_ring(x->fill);
+    unmap_ring(x->completion);
+    unmap_ring(x->rx);
+    unmap_ring(x->tx);
+    if (x->xsk >= 0) close(x->xsk);
+    if (x->umem) munmap(x->umem, x->umemLen);
+    delete x;
+}
+
+static bool get_interface_info(xdp_udp* x) noexcept
+{
+    struct ifreq ifr;
+    memset(&ifr, 0, sizeof(ifr));
+    memcpy(ifr.ifr_name, x->ifname, IF_NAMESIZE);
+    if (ioctl(x->udpSocket, SIOCGIFHWADDR, &ifr) < 0)
+        return false;
+    memcpy(x->localMac, ifr.ifr_hwaddr.sa_data, 6);
+    if (ioctl(x->udpSocket, SIOCGIFADDR, &ifr) < 0)
+        return false; // no IPv4 address
+    x->localAddr = ((struct sockaddr_in*)&ifr.ifr_addr)->sin_addr.s_addr;
+    return true;
+}
+
+static void learn_neighbor(xdp_udp* x, uint32_t addr, const uint8_t* mac) noexcept
+{
+    for (int i = 0; i < x->numNeighbors; ++i) {
+        if (x->neighbors[i].addr == addr) {
+            memcpy(x->neighbors[i].mac, mac, 6);
+            return;
+        }
+    }
+    neighbor& n = x->neighbors[x->nextNeighbor];
+    x->nextNeighbor = (x->nextNeighbor + 1) % MAX_NEIGHBORS;
+    if (x->numNeighbors < MAX_NEIGHBORS) ++x->numNeighbors;
+    n.addr = addr;
+    memcpy(n.mac, mac, 6);
+}
+
+// next hop MAC: learned from received frames (which also covers routed peers),
+// otherwise from the kernel ARP table
+static const uint8_t* find_neighbor(xdp_udp* x, uint32_t addr) noexcept
+{
+    for (int i = 0; i < x->numNeighbors; ++i)
+        if (x->neighbors[i].addr == addr)
+            return x->neighbors[i].mac;
+
+    struct arpreq req;
+    memset(&req, 0, sizeof(req));
+    struct sockaddr_in* pa = (struct sockaddr_in*)&req.arp_pa;
+    pa->sin_family = AF_INET;
+    pa->sin_addr.s_addr = addr;
+    memcpy(req.arp_dev, x->ifname, IF_NAMESIZE);
+    if (ioctl(x->udpSocket, SIOCGARP, &req) < 0 || !(req.arp_flags & ATF_COM))
+        return nullptr;
+    learn_neighbor(x, addr, (const uint8_t*)req.arp_ha.sa_data);
+    return find_neighbor(x, addr);
+}
+
+static uint16_t ipv4_checksum(const uint8_t* header) noexcept
+{
+    uint32_t sum = 0;
+    for (int i = 0; i < 20; i += 2)
+        sum += uint32_t(header[i] << 8 | header[i + 1]);
+    while (sum >> 16)
+        sum = (sum & 0xffff) + (sum >> 16);
+    return htons(uint16_t(~sum));
+}
+
+// frames the kernel has finished sending become free again
+static void reap_completions(xdp_udp* x) noexcept
+{
+    uint32_t producer = __atomic_load_n(x->completion.producer, __ATOMIC_ACQUIRE);
+    uint32_t& consumer = x->completion.local;
+    if (producer == consumer)
+        return;
+    for (; consumer != producer; ++consumer)
+        x->freeTxFrames.push_back(x->completion.addrs()[consumer & (RING_SIZE - 1)]);
+    __atomic_store_n(x->completion.consumer, consumer, __ATOMIC_RELEASE);
+}
+
+static void kick_tx(xdp_udp* x) noexcept
+{
+    ++x->syscalls;
+    sendto(x->xsk, nullptr, 0, MSG_DONTWAIT, nullptr, 0);
+}
+
+// @return UMEM address of a free tx frame, 0 if none became free
+static uint64_t alloc_tx_frame(xdp_udp* x) noexcept
+{
+    for (int attempt = 0; x->freeTxFrames.empty() && attempt < 1000; ++attempt) {
+        reap_completions(x);
+        if (!x->freeTxFrames.empty()) break;
+        if (xdp_udp_submit(x) == 0) // the kernel only sends what we published and kicked
+            kick_tx(x);
+        reap_completions(x);
+        if (!x->freeTxFrames.empty()) break;
+        struct timespec ts { 0, 10000 };
+        nanosleep(&ts, nullptr);
+    }
+    if (x->freeTxFrames.empty())
+        return 0;
+    uint64_t addr = x->freeTxFrames.back();
+    x->freeTxFrames.pop_back();
+    return addr;
+}
+
+// builds Ethernet + IPv4 + UDP headers in front of `len` payload bytes and queues the frame
+static bool queue_frame(xdp_udp* x, const uint8_t* mac, uint32_t addr, uint16_t port,
+                        const void* data, int len) noexcept
+{
+    uint64_t frame = alloc_tx_frame(x);
+    if (frame == 0)
+        return false;
+    uint8_t* p = (uint8_t*)x->umem + frame;
+
+    memcpy(p, mac, 6);
+    memcpy(p + 6, x->localMac, 6);
+    p[12] = 0x08; p[13] = 0x00; // IPv4
+
+    uint8_t* ip = p + 14;
+    uint16_t totalLen = htons(uint16_t(20 + 8 + len));
+    uint16_t id = htons(x->ipId++);
+    ip[0] = 0x45; // version 4, 20 byte header
+    ip[1] = 0;
+    memcpy(ip + 2, &totalLen, 2);
+    memcpy(ip + 4, &id, 2);
+    ip[6] = 0x40; ip[7] = 0; // don't fragment
+    ip[8] = 64; // ttl
+    ip[9] = IPPROTO_UDP;
+    ip[10] = ip[11] = 0;
+    memcpy(ip + 12, &x->localAddr, 4);
+    memcpy(ip + 16, &addr, 4);
+    uint16_t checksum = ipv4_checksum(ip);
+    memcpy(ip + 10, &checksum, 2);
+
+    uint8_t* udp = ip + 20;
+    uint16_t srcPort = htons(x->localPort);
+    uint16_t dstPort = htons(port);
+    uint16_t udpLen = htons(uint16_t(8 + len));
+    memcpy(udp, &srcPort, 2);
+    memcpy(udp + 2, &dstPort, 2);
+    memcpy(udp + 4, &udpLen, 2);
+    udp[6] = udp[7] = 0; // no checksum, optional for IPv4
+    memcpy(udp + 8, data, len);
+
+    struct xdp_desc& desc = x->tx.descs()[x->tx.local & (RING_SIZE - 1)];
+    desc.addr = frame;
+    desc.len = uint32_t(HEADERS_SIZE + len);
+    desc.options = 0;
+    ++x->tx.local;
+    ++x->txQueued;
+    return true;
+}
+
+// @return false if this is not an IPv4 UDP datagram
+static bool parse_frame(xdp_udp* x, const struct xdp_desc& desc, udp_msg& m) noexcept
+{
+    uint8_t* p = (uint8_t*)x->umem + desc.addr;
+    int len = int(desc.len);
+    if (len < HEADERS_SIZE || p[12] != 0x08 || p[13] != 0x00)
+        return false;
+    uint8_t* ip = p + 14;
+    int ipHeaderLen = (ip[0] & 0x0f) * 4;
+    if (ip[9] != IPPROTO_UDP || ipHeaderLen < 20 || len < 14 + ipHeaderLen + 8)
+        return false;
+    uint8_t* udp = ip + ipHeaderLen;
+    uint16_t srcPort, udpLen;
+    memcpy(&srcPort, udp, 2);
+    memcpy(&udpLen, udp + 4, 2);
+    int payloadLen = int(ntohs(udpLen)) - 8;
+    int available = len - (14 + ipHeaderLen + 8);
+    if (payloadLen < 0 || payloadLen > available)
+        payloadLen = available;
+
+    memset(&m, 0, sizeof(m));
+    m.data = udp + 8;
+    m.size = payloadLen;
+    m.len = payloadLen;
+    memcpy(&m.addr, ip + 12, 4);
+    m.port = ntohs(srcPort);
+    learn_neighbor(x, m.addr, p + 6);
+    return true;
+}
+
+static void refill(xdp_udp* x, uint64_t frame) noexcept
+{
+    x->fill.addrs()[x->fill.local & (RING_SIZE - 1)] = frame;
+    ++x->fill.local;
+}
+
+xdp_udp* xdp_udp_create(int udp_socket, const char* ifname, int queue_id, int local_port) noexcept
+{
+    int ifindex = int(if_nametoindex(ifname));
+    if (ifindex == 0)
+        return nullptr;
+
+    xdp_udp* x = new xdp_udp{};
+    x->udpSocket = udp_socket;
+    strncpy(x->ifname, ifname, IF_NAMESIZE - 1);
+    x->localPort = uint16_t(local_port);
+    if (!get_interface_info(x)) { destroy(x); return nullptr; }
+
+    x->xsk = socket(AF_XDP, SOCK_RAW, 0);
+    if (x->xsk < 0) { destroy(x); return nullptr; }
+
+    x->umemLen = size_t(NUM_FRAMES) * FRAME_SIZE;
+    void* umem = mmap(nullptr, x->umemLen, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS|MAP_POPULATE, -1, 0);
+    if (umem == MAP_FAILED) { destroy(x); return nullptr; }
+    x->umem = (char*)umem;
+
+    struct xdp_umem_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.addr = uint64_t(uintptr_t(x->umem));
+    reg.len = x->umemLen;
+    reg.chunk_size = FRAME_SIZE;
+    reg.headroom = 0;
+    int ringSize = RING_SIZE;
+    if (setsockopt(x->xsk, SOL_XDP, XDP_UMEM_REG, &reg, sizeof(reg)) < 0 ||
+        setsockopt(x->xsk, SOL_XDP, XDP_UMEM_FILL_RING, &ringSize, sizeof(ringSize)) < 0 ||
+        setsockopt(x->xsk, SOL_XDP, XDP_UMEM_COMPLETION_RING, &ringSize, sizeof(ringSize)) < 0 ||
+        setsockopt(x->xsk, SOL_XDP, XDP_RX_RING, &ringSize, sizeof(ringSize)) < 0 ||
+        setsockopt(x->xsk, SOL_XDP, XDP_TX_RING, &ringSize, sizeof(ringSize)) < 0) {
+        destroy(x);
+        return nullptr;
+    }
+
+    struct xdp_mmap_offsets off;
+    socklen_t offLen = sizeof(off);
+    if (getsockopt(x->xsk, SOL_XDP, XDP_MMAP_OFFSETS, &off, &offLen) < 0 ||
+        !map_ring(x->xsk, x->fill, off.fr, sizeof(uint64_t), XDP_UMEM_PGOFF_FILL_RING) ||
+        !map_ring(x->xsk, x->completion, off.cr, sizeof(uint64_t), XDP_UMEM_PGOFF_COMPLETION_RING) ||
+        !map_ring(x->xsk, x->rx, off.rx, sizeof(struct xdp_desc), XDP_PGOFF_RX_RING) ||
+        !map_ring(x->xsk, x->tx, off.tx, sizeof(struct xdp_desc), XDP_PGOFF_TX_RING)) {
+        destroy(x);
+        return nullptr;
+    }
+
+    // rx frames wait in the fill ring, tx frames in our free list
+    for (int i = 0; i < RX_FRAMES; ++i)
+        refill(x, uint64_t(i) * FRAME_SIZE);
+    __atomic_store_n(x->fill.producer, x->fill.local, __ATOMIC_RELEASE);
+    x->freeTxFrames.reserve(NUM_FRAMES - RX_FRAMES);
+    for (int i = NUM_FRAMES - 1; i >= RX_FRAMES; --i)
+        x->freeTxFrames.push_back(uint64_t(i) * FRAME_SIZE);
+    x->held.reserve(RING_SIZE);
+
+    // zero-copy needs driver support, veth and loopback only do copy mode
+    struct sockaddr_xdp sxdp;
+    memset(&sxdp, 0, sizeof(sxdp));
+    sxdp.sxdp_family = AF_XDP;
+    sxdp.sxdp_ifindex = uint32_t(ifindex);
+    sxdp.sxdp_queue_id = uint32_t(queue_id);
+    sxdp.sxdp_flags = XDP_USE_NEED_WAKEUP | XDP_ZEROCOPY;
+    x->zeroCopy = bind(x->xsk, (struct sockaddr*)&sxdp, sizeof(sxdp)) == 0;
+    if (!x->zeroCopy) {
+        sxdp.sxdp_flags = XDP_USE_NEED_WAKEUP | XDP_COPY;
+        if (bind(x->xsk, (struct sockaddr*)&sxdp, sizeof(sxdp)) < 0) { destroy(x); return nullptr; }
+    }
+
+    union bpf_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.map_type = BPF_MAP_TYPE_XSKMAP;
+    attr.key_size = sizeof(int);
+    attr.value_size = sizeof(int);
+    attr.max_entries = uint32_t(queue_id + 1);
+    x->mapFd = sys_bpf(BPF_MAP_CREATE, &attr);
+    if (x->mapFd < 0) { destroy(x); return nullptr; }
+
+    int key = queue_id;
+    int value = x->xsk;
+    memset(&attr, 0, sizeof(attr));
+    attr.map_fd = uint32_t(x->mapFd);
+    attr.key = uint64_t(uintptr_t(&key));
+    attr.value = uint64_t(uintptr_t(&value));
+    if (sys_bpf(BPF_MAP_UPDATE_ELEM, &attr) < 0) { destroy(x); return nullptr; }
+
+    x->progFd = load_steering_program(x->mapFd, x->localPort);
+    if (x->progFd < 0) { destroy(x); return nullptr; }
+    x->linkFd = attach_program(x->progFd, ifindex, XDP_FLAGS_DRV_MODE);
+    x->native = x->linkFd >= 0;
+    if (!x->native) {
+        x->linkFd = attach_program(x->progFd, ifindex, XDP_FLAGS_SKB_MODE);
+        if (x->linkFd < 0) { destroy(x); return nullptr; }
+    }
+    return x;
+}
+
+void xdp_udp_destroy(xdp_udp* xdp) noexcept
+{
+    if (xdp) destroy(xdp);
+}
+
+bool xdp_udp_zero_copy(const xdp_udp* xdp) noexcept { return xdp->zeroCopy; }
+bool xdp_udp_native(const xdp_udp* xdp) noexcept { return xdp->native; }
+
+bool xdp_udp_queue_send(xdp_udp* x, const udp_msg* msg) noexcept
+{
+    const uint8_t* mac = find_neighbor(x, msg->addr);
+    if (!mac) { // the kernel resolves it for us, later sends will find it in the ARP table
+        ++x->kernelSends;
+        ++x->syscalls;
+        return socket_sendmmsg(x->udpSocket, const_cast<udp_msg*>(msg), 1) == 1;
+    }
+
+    int segment = (msg->gso_size > 0 && msg->size > msg->gso_size) ? msg->gso_size : msg->size;
+    if (segment > FRAME_SIZE - HEADERS_SIZE)
+        return false;
+    for (int offset = 0; offset < msg->size; offset += segment) {
+        int len = msg->size - offset < segment ? msg->size - offset : segment;
+        if (!queue_frame(x, mac, msg->addr, msg->port, (const char*)msg->data + offset, len))
+            return false;
+    }
+    return true;
+}
+
+int xdp_udp_submit(xdp_udp* x) noexcept
+{
+    int submitted = int(x->txQueued);
+    if (submitted == 0)
+        return 0;
+    __atomic_store_n(x->tx.producer, x->tx.local, __ATOMIC_RELEASE);
+    x->txQueued = 0;
+    if (x->tx.needsWakeup())
+        kick_tx(x);
+    reap_completions(x);
+    return submitted;
+}
+
+int xdp_udp_recv(xdp_udp* x, udp_msg* msgs, int count, int timeout_ms) noexcept
+{
+    // the caller is done with the previous batch
+    if (!x->held.empty()) {
+        for (uint64_t frame : x->held)
+            refill(x, frame);
+        __atomic_store_n(x->fill.producer, x->fill.local, __ATOMIC_RELEASE);
+        x->held.clear();
+    }
+    xdp_udp_submit(x);
+    reap_completions(x);
+
+    int64_t deadline = 0;
+    if (timeout_ms > 0) {
+        timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        deadline = int64_t(now.tv_sec) * 1000 + now.tv_nsec / 1000000 + timeout_ms;
+    }
+
+    for (;;) {
+        uint32_t producer = __atomic_load_n(x->rx.producer, __ATOMIC_ACQUIRE);
+        uint32_t& consumer = x->rx.local;
+        int n = 0;
+        bool refilled = false;
+        for (; consumer != producer && n < count; ++consumer) {
+            const struct xdp_desc& desc = x->rx.descs()[consumer & (RING_SIZE - 1)];
+            uint64_t frame = desc.addr & ~uint64_t(FRAME_SIZE - 1);
+            if (parse_frame(x, desc, msgs[n])) {
+                x->held.push_back(frame); // recycled on the next call
+                ++n;
+            } else {
+                refill(x, frame);
+                refilled = true;
+            }
+        }
+        __atomic_store_n(x->rx.consumer, consumer, __ATOMIC_RELEASE);
+        if (refilled)
+            __atomic_store_n(x->fill.producer, x->fill.local, __ATOMIC_RELEASE);
+        if (n > 0)
+            return n;
+
+        int waitMs = timeout_ms;
+        if (timeout_ms > 0) {
+            timespec now;
+            clock_gettime(CLOCK_MONOTONIC, &now);
+            int64_t remaining = deadline - (int64_t(now.tv_sec) * 1000 + now.tv_nsec / 1000000);
+            if (remaining <= 0) return 0;
+            waitMs = int(remaining);
+        }
+        if (timeout_ms == 0) {
+            if (x->fill.needsWakeup()) { // the driver stopped because the fill ring ran dry
+                ++x->syscalls;
+                recvfrom(x->xsk, nullptr, 0, MSG_DONTWAIT, nullptr, nullptr);
+            }
+            return 0;
+        }
+        struct pollfd pfd { x->xsk, POLLIN, 0 };
+        ++x->syscalls;
+        if (poll(&pfd, 1, waitMs) < 0 && errno != EINTR)
+            return -1;
+    }
+}
+
+int64_t xdp_udp_syscalls(const xdp_udp* xdp) noexcept { return xdp->syscalls; }
+int64_t xdp_udp_kernel_sends(const xdp_udp* xdp) noexcept { return xdp->kernelSends; }
+
+#else // !UDP_HAS_AF_XDP
+
+xdp_udp* xdp_udp_create(int, const char*, int, int) noexcept { return nullptr; }
+void xdp_udp_destroy(xdp_udp*) noexcept {}
+bool xdp_udp_zero_copy(const xdp_udp*) noexcept { return false; }
+bool xdp_udp_native(const xdp_udp*) noexcept { return false; }
+bool xdp_udp_queue_send(xdp_udp*, const udp_msg*) noexcept { return false; }
+int xdp_udp_submit(xdp_udp*) noexcept { return -1; }
+int xdp_udp_recv(xdp_udp*, udp_msg*, int, int) noexcept { return -1; }
+int64_t xdp_udp_syscalls(const xdp_udp*) noexcept { return 0; }
+int64_t xdp_udp_kernel_sends(const xdp_udp*) noexcept { return 0; }
+
+#endif
@@ -0,0 +1,45 @@
+#pragma once
+#include "simple_udp.h"
+
+// AF_XDP UDP engine for line-rate tests, using raw syscalls (no libbpf/libxdp)
+//
+// an XDP program redirects IPv4 UDP datagrams for `local_port` on one NIC queue
+// into an AF_XDP socket, so they skip the kernel network stack and its socket buffer drops.
+// received datagrams are returned in place inside the UMEM frames, without any copies.
+// sent datagrams get their Ethernet/IPv4/UDP headers built here and go straight to the NIC queue.
+//
+// zero-copy needs driver support, otherwise the kernel copies into the UMEM (veth, loopback)
+struct xdp_udp;
+
+// @param udp_socket kernel socket bound to `local_port`, used to send until the
+//                   destination MAC is known, it receives whatever XDP does not redirect
+// @param ifname interface to attach to, e.g. "eth0"
+// @param queue_id NIC RX/TX queue, other queues are not redirected (see ethtool -L/-N)
+// @return nullptr if AF_XDP is not supported or the program could not be attached
+xdp_udp* xdp_udp_create(int udp_socket, const char* ifname, int queue_id, int local_port) noexcept;
+void xdp_udp_destroy(xdp_udp* xdp) noexcept;
+
+// true if the NIC DMAs directly into the UMEM, false in copy mode
+bool xdp_udp_zero_copy(const xdp_udp* xdp) noexcept;
+// true if the XDP program runs in the driver, false for generic (skb) XDP
+bool xdp_udp_native(const xdp_udp* xdp) noexcept;
+
+// copies the datagram into a free UMEM frame behind freshly built headers,
+// UDP_SEGMENT super-buffers (udp_msg::gso_size) are split into one frame per segment
+// @return false if the datagram is too big or no frame became free
+bool xdp_udp_queue_send(xdp_udp* xdp, const udp_msg* msg) noexcept;
+
+// kicks the TX ring if the kernel needs a wakeup
+// @return number of frames submitted, or <0 on error
+int xdp_udp_submit(xdp_udp* xdp) noexcept;
+
+// waits up to `timeout_ms` (-1: forever) for received datagrams
+// msgs[i].data points into the UMEM, which stays valid until the next xdp_udp_recv()
+// @return number of datagrams received, 0 on timeout, or <0 on error
+int xdp_udp_recv(xdp_udp* xdp, udp_msg* msgs, int count, int timeout_ms) noexcept;
+
+// poll/sendto/recvfrom syscalls made so far, for syscall accounting
+int64_t xdp_udp_syscalls(const xdp_udp* xdp) noexcept;
+
+// datagrams sent through the kernel socket because the destination MAC was unknown
+int64_t xdp_udp_kernel_sends(const xdp_udp* xdp) noexcept;
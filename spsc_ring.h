@@ -0,0 +1,152 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <type_traits>
+#include <stdint.h>
+#include <sys/mman.h>
+#if __x86_64__ || __i386__
+    #include <immintrin.h> // _mm_pause
+#endif
+
+/**
+ * Lock-free single producer / single consumer ring of preallocated slots.
+ *
+ * The producer fills `beginPush()` in place and publishes it with `commitPush()`,
+ * the consumer reads `front()` in place and releases it with `pop()`, so nothing is
+ * allocated or copied twice. Each side owns its position on a separate cache line
+ * and caches the other side's position, so the shared line is only re-read when
+ * the ring looks full (producer) or empty (consumer).
+ *
+ * The producer tracks the high-water mark and the pushes rejected because the ring was full,
+ * which tells a slow consumer apart from losses before the ring.
+ *
+ * Slots are an anonymous mmap which is not populated, so only the slots the ring actually
+ * reaches get backing memory. T is written in place before it's read, it's never constructed.
+ */
+template<class T>
+struct SpscRing
+{
+    static constexpr int CACHE_LINE = 64;
+    static constexpr int32_t MAX_CAPACITY = 65536;
+    static_assert(std::is_trivially_destructible_v<T>, "slots are unmapped without destroying them");
+
+    int32_t capacity = 0; // power of 2, 0 if the slots couldn't be mapped
+    T* slots = nullptr;
+    size_t mapLen = 0;
+
+    // producer side
+    alignas(CACHE_LINE) std::atomic<uint32_t> tail { 0 }; // next slot to push
+    uint32_t cachedHead = 0;
+    std::atomic<int32_t> highWater { 0 }; // max slots in use since resetStats()
+    std::atomic<int64_t> fullDrops { 0 }; // pushes rejected because the ring was full
+
+    // consumer side
+    alignas(CACHE_LINE) std::atomic<uint32_t> head { 0 }; // next slot to pop
+    uint32_t cachedTail = 0;
+
+    explicit SpscRing(int32_t slotCount) noexcept
+    {
+        int32_t pow2 = 64;
+        while (pow2 < slotCount && pow2 < MAX_CAPACITY) pow2 <<= 1;
+        mapLen = sizeof(T) * size_t(pow2);
+        void* map = mmap(nullptr, mapLen, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+        if (map == MAP_FAILED)
+            return;
+        slots = static_cast<T*>(map);
+        capacity = pow2;
+    }
+
+    ~SpscRing() noexcept
+    {
+        if (slots) munmap(slots, mapLen);
+    }
+
+    SpscRing(const SpscRing&) = delete;
+    SpscRing& operator=(const SpscRing&) = delete;
+
+    // producer: the next free slot, or nullptr if the ring is full
+    T* beginPush() noexcept
+    {
+        uint32_t t = tail.load(std::memory_order_relaxed);
+        if (int32_t(t - cachedHead) >= capacity) {
+            cachedHead = head.load(std::memory_order_acquire);
+            if (int32_t(t - cachedHead) >= capacity) {
+                fullDrops.fetch_add(1, std::memory_order_relaxed);
+                return nullptr;
+            }
+        }
+        return &slots[t & (capacity - 1)];
+    }
+
+    // producer: publishes the slot returned by beginPush()
+    void commitPush() noexcept
+    {
+        uint32_t t = tail.load(std::memory_order_relaxed) + 1;
+        tail.store(t, std::memory_order_release);
+        // the cached head is stale, so only refresh it when this could be a new high-water
+        if (int32_t(t - cachedHead) > highWater.load(std::memory_order_relaxed)) {
+            cachedHead = head.load(std::memory_order_acquire);
+            if (int32_t(t - cachedHead) > highWater.load(std::memory_order_relaxed))
+                highWater.store(int32_t(t - cachedHead), std::memory_order_relaxed);
+        }
+    }
+
+    // consumer: the oldest published slot, or nullptr if the ring is empty
+    T* front() noexcept
+    {
+        uint32_t h = head.load(std::memory_order_relaxed);
+        if (h == cachedTail) {
+            cachedTail = tail.load(std::memory_order_acquire);
+            if (h == cachedTail)
+                return nullptr;
+        }
+        return &slots[h & (capacity - 1)];
+    }
+
+    // consumer: releases the slot returned by front()
+    void pop() noexcept
+    {
+        head.store(head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    // any thread: slots pushed but not popped yet
+    int32_t size() const noexcept
+    {
+        return int32_t(tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire));
+    }
+
+    // any thread: waits until the consumer has popped everything pushed so far
+    // @return false if it did not catch up within timeoutNs
+    bool drain(int64_t timeoutNs) const noexcept
+    {
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::nanoseconds(timeoutNs);
+        while (size() > 0) {
+            if (std::chrono::steady_clock::now() >= deadline)
+                return false;
+            std::this_thread::yield();
+        }
+        return true;
+    }
+
+    // any thread: restarts the high-water mark and drop count
+    void resetStats() noexcept
+    {
+        highWater.store(size(), std::memory_order_relaxed);
+        fullDrops.store(0, std::memory_order_relaxed);
+    }
+};
+
+// consumer backoff when the ring is empty: spin briefly, then sleep so an idle worker doesn't burn a core
+inline void spscIdleWait(int& idleSpins) noexcept
+{
+    if (++idleSpins < 256) {
+    #if __x86_64__ || __i386__
+        _mm_pause();
+    #else
+        std::this_thread::yield();
+    #endif
+    } else {
+        std::this_thread::sleep_for(std::chrono::microseconds(50));
+    }
+}
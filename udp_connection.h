@@ -1,8 +1,23 @@
 #pragma once
 #include "logging.h"
 #include "simple_udp.h"
+#include "simple_uring.h"
+#include "simple_xdp.h"
 #include "packets.h"
+#include "utils.h"
+#include "latency_histogram.h"
+#include "pacer.h"
+#include "profiler.h"
+#include "async_log.h"
+#include "net_stats.h"
 #include <rpp/sockets.h>
+#include <vector>
+#include <atomic>
+#include <string.h> // memcpy
+#include <errno.h> // EAGAIN
+
+// max size of a single datagram we can receive
+static constexpr int MAX_PACKET_SIZE = 4096;
 
 /**
  * Abstract UDP connection
@@ -14,18 +29,266 @@ struct UDPConnection
     bool useRpp;
 
     // rate limiter
-    rpp::load_balancer balancer { uint32_t(8 * 1024 * 1024) };
-    char buffer[4096];
+    enum class Pacing { USER, KERNEL, TXTIME };
+    Pacing pacing = Pacing::USER; // KERNEL: SO_MAX_PACING_RATE, TXTIME: SO_TXTIME launch times
+    Pacer pacer;
+    int64_t nextTxTimeNs = 0; // SO_TXTIME launch time for the next queued packet
+    char buffer[MAX_PACKET_SIZE];
+    Packet* received = reinterpret_cast<Packet*>(buffer); // last received packet
+    int64_t recvTimeNs = 0; // nowNanos() when the last received packet was read
+
+    // batched sendmmsg/recvmmsg, 1 means one syscall per packet
+    int batchSize = 1;
+    std::vector<char> txBuffers;
+    std::vector<udp_msg> txMsgs;
+    int txCount = 0; // number of queued packets in txMsgs
+    bool stampQueuedData = false; // client and server: DATA in txMsgs gets its sendTimeNs when the batch leaves
+    std::vector<char> rxBuffers;
+    std::vector<udp_msg> rxMsgs;
+    int rxCount = 0; // number of received packets in rxMsgs
+    int rxNext = 0; // next packet in rxMsgs to return
+
+    // UDP_SEGMENT / UDP_GRO: one msg carries up to 64KB of mtu sized datagrams
+    bool gso = false;
+    bool gro = false;
+    int txSlotSize = MAX_PACKET_SIZE; // bytes per txMsgs buffer
+    int rxSlotSize = MAX_PACKET_SIZE; // bytes per rxMsgs buffer
+    int rxSegOffset = 0; // GRO: offset of the next segment in rxMsgs[rxNext]
+
+    // --engine uring|xdp: sends and receives go through io_uring or AF_XDP instead of sendmmsg/recvmmsg
+    enum class Engine { POLL, URING, XDP };
+    uring_udp* uring = nullptr;
+    xdp_udp* xdp = nullptr;
+
+    // syscall accounting
+    struct IOStats
+    {
+        int64_t sendCalls = 0; // sendto/sendmmsg/io_uring_enter/AF_XDP kick calls
+        int64_t recvCalls = 0; // recvfrom/recvmmsg/io_uring_enter/AF_XDP calls
+        int64_t pollCalls = 0; // poll() waits before recvfrom/recvmmsg
+        int64_t sent = 0; // datagrams sent
+        int64_t received = 0; // datagrams received
+
+        IOStats operator-(const IOStats& o) const noexcept {
+            return { sendCalls - o.sendCalls, recvCalls - o.recvCalls, pollCalls - o.pollCalls,
+                     sent - o.sent, received - o.received };
+        }
+        double sendCallsPerPacket() const noexcept { return sent ? double(sendCalls) / sent : 0.0; }
+        double recvCallsPerPacket() const noexcept { return received ? double(recvCalls) / received : 0.0; }
+        double pollCallsPerPacket() const noexcept { return received ? double(pollCalls) / received : 0.0; }
+    };
+    IOStats stats;
+
+    // SO_TIMESTAMPING: kernel RX timestamps replace recvTimeNs, TX timestamps time the send path
+    bool timestamping = false;
+    static constexpr int TX_HISTORY = 4096; // power of 2
+    std::vector<int64_t> txSendTimes; // send syscall time of the last TX_HISTORY datagrams, negative if not DATA
+    uint32_t txIds = 0; // datagrams sent since timestamping was enabled, same as the kernel's OPT_ID
+    int64_t rxReadTimeNs = 0; // when the current receive batch was read
+    LatencyHistogram rxQueueDelay; // kernel RX timestamp -> read by us, i.e. socket buffer queueing
+    LatencyHistogram txStackDelay; // send syscall -> kernel TX timestamp
+    LatencyHistogram txGap; // between consecutive kernel TX timestamps, i.e. the actual send pacing
+    int64_t lastTxTimestampNs = 0;
+
+    // SO_RXQ_OVFL: datagrams this socket dropped because its receive buffer was full,
+    // only updated when a datagram arrives, so drops show up with the next received packet.
+    // It comes as a recvmsg control message, the single datagram recvfrom path reads the same counter
+    // from /proc/net/udp instead, only when a STATUS arrives, since that costs a file read
+    bool rxqOvfl = false;
+    std::atomic<uint32_t> socketDrops { 0 }; // read by peer shards
+
+    bool sharedSocket = false; // c_sock belongs to another connection, see shareSocket()
 
     explicit UDPConnection(bool useRpp) noexcept : useRpp{useRpp} {}
 
     ~UDPConnection() noexcept
     {
+        uring_udp_destroy(uring);
+        xdp_udp_destroy(xdp);
         if (useRpp) socket.close();
-        else        socket_udp_close(c_sock);
+        else if (!sharedSocket) socket_udp_close(c_sock);
+    }
+
+    int32_t getRateLimit() const noexcept { return pacer.getRate(); }
+
+    void setRateLimit(int32_t bytesPerSec) noexcept
+    {
+        pacer.setRate(bytesPerSec);
+        if (pacing == Pacing::KERNEL && !socket_set_max_pacing_rate(fd(), uint32_t(pacer.getRate())))
+            LogError(RED("SO_MAX_PACING_RATE %s failed: %s"), toRateLiteral(bytesPerSec), rpp::socket::last_os_socket_err());
+    }
+
+    // hands pacing to the kernel, the egress qdisc must be fq (or etf for TXTIME)
+    bool setPacing(Pacing mode) noexcept
+    {
+        if (mode == Pacing::TXTIME && !socket_enable_txtime(fd()))
+            return false;
+        pacing = mode;
+        setRateLimit(pacer.getRate());
+        allocateMsgs();
+        return true;
+    }
+
+    // with kernel pacing our sends return immediately,
+    // so this waits until the kernel has actually sent everything
+    void waitForPacedSends(int timeoutMillis) noexcept
+    {
+        if (pacing == Pacing::USER)
+            return;
+        flushSends();
+        int64_t deadline = Pacer::monotonicNs() + int64_t(timeoutMillis) * 1000000;
+        while (socket_get_unsent_bytes(fd()) > 0 && Pacer::monotonicNs() < deadline)
+            Pacer::sleepUntil(Pacer::monotonicNs() + 100'000);
+    }
+
+    int fd() const noexcept { return useRpp ? socket.oshandle() : c_sock; }
+
+    void setBatchSize(int size) noexcept
+    {
+        batchSize = size > 1 ? size : 1;
+        allocateMsgs();
+    }
+
+    // sendmmsg/recvmmsg are needed for batching and for anything passed as control messages,
+    // so single packets go through them too in those modes
+    bool useTxMsgs() const noexcept { return batchSize > 1 || gso || pacing == Pacing::TXTIME || hasEngine(); }
+    bool useRxMsgs() const noexcept { return batchSize > 1 || gro || timestamping || hasEngine(); }
+
+    Engine engine() const noexcept { return uring ? Engine::URING : xdp ? Engine::XDP : Engine::POLL; }
+    bool hasEngine() const noexcept { return engine() != Engine::POLL; }
+    static const char* engineName(Engine e) noexcept
+    {
+        return e == Engine::URING ? "uring" : e == Engine::XDP ? "xdp" : "poll";
+    }
+
+    void allocateMsgs() noexcept
+    {
+        txCount = rxCount = rxNext = rxSegOffset = 0;
+        if (useTxMsgs()) {
+            txBuffers.resize(size_t(batchSize) * txSlotSize);
+            txMsgs.resize(batchSize);
+        }
+        if (useRxMsgs()) {
+            rxMsgs.resize(batchSize);
+            if (hasEngine()) return; // received datagrams point into the io_uring buffers or UMEM
+            rxBuffers.resize(size_t(batchSize) * rxSlotSize);
+            for (int i = 0; i < batchSize; ++i)
+                rxMsgs[i] = { &rxBuffers[size_t(i) * rxSlotSize], rxSlotSize, 0, 0, 0, 0, 0, 0, 0 };
+        }
+    }
+
+    // call after enableGso/enableGro, since the ring buffers are sized for them
+    bool enableUring() noexcept
+    {
+        int numBuffers = gro ? 256 : 4096; // 16MB either way
+        int numSendSlots = std::max(256, batchSize * 4);
+        uring = uring_udp_create(fd(), numBuffers, rxSlotSize, numSendSlots, txSlotSize);
+        if (!uring)
+            return false;
+        allocateMsgs();
+        return true;
+    }
+
+    // DATA and STATUS to our port on `ifname` queue `queueId` bypass the kernel stack
+    bool enableXdp(const char* ifname, int queueId) noexcept
+    {
+        int localPort = socket_local_port(fd()); // the client binds an ephemeral port here
+        if (localPort <= 0)
+            return false;
+        xdp = xdp_udp_create(fd(), ifname, queueId, localPort);
+        if (!xdp)
+            return false;
+        allocateMsgs();
+        return true;
+    }
+
+    // consecutive DATA packets to the same address are sent as one UDP_SEGMENT super-buffer
+    bool enableGso() noexcept
+    {
+        if (!socket_enable_gso(fd()))
+            return false;
+        gso = true;
+        txSlotSize = UDP_MAX_GSO_SIZE;
+        allocateMsgs();
+        return true;
+    }
+
+    // received super-buffers are split back into the original datagrams by recvBatched
+    bool enableGro() noexcept
+    {
+        if (!socket_enable_gro(fd()))
+            return false;
+        gro = true;
+        rxSlotSize = 65536;
+        allocateMsgs();
+        return true;
+    }
+
+    bool hasPendingSends() const noexcept { return txCount > 0; }
+
+    bool enableTimestamping(bool hardware) noexcept
+    {
+        if (!socket_enable_timestamping(fd(), hardware))
+            return false;
+        timestamping = true;
+        txIds = 0;
+        txSendTimes.assign(TX_HISTORY, 0);
+        allocateMsgs();
+        return true;
+    }
+
+    bool enableRxqOvfl() noexcept
+    {
+        if (!socket_enable_rxq_ovfl(fd()))
+            return false;
+        rxqOvfl = true;
+        return true;
+    }
+
+
+    void resetTimestampStats() noexcept
+    {
+        rxQueueDelay.reset();
+        txStackDelay.reset();
+        txGap.reset();
+        lastTxTimestampNs = 0;
+    }
+
+    // remembers when these datagrams were handed to the kernel
+    void onDatagramsSent(const udp_msg* msgs, int count, int64_t sendTimeNs) noexcept
+    {
+        if (!timestamping) return;
+        for (int i = 0; i < count; ++i) {
+            bool isData = static_cast<const Packet*>(msgs[i].data)->type == PacketType::DATA;
+            txSendTimes[(txIds++) & (TX_HISTORY - 1)] = isData ? sendTimeNs : -sendTimeNs;
+        }
+        readTxTimestamps();
     }
 
-    int32_t getRateLimit() const noexcept { return balancer.get_max_bytes_per_sec(); }
+    // drains the error queue, otherwise poll() keeps waking up with POLLERR
+    void readTxTimestamps() noexcept
+    {
+        uint32_t ids[64];
+        int64_t times[64];
+        int n;
+        do {
+            n = socket_read_tx_timestamps(fd(), ids, times, 64);
+            for (int i = 0; i < n; ++i) {
+                if (txIds - ids[i] > uint32_t(TX_HISTORY))
+                    continue; // too old, send time was already overwritten
+                int64_t sendTime = txSendTimes[ids[i] & (TX_HISTORY - 1)];
+                if (sendTime == 0) continue;
+                txStackDelay.record(times[i] - (sendTime > 0 ? sendTime : -sendTime));
+                if (sendTime < 0) { // STATUS packets separate the DATA bursts
+                    lastTxTimestampNs = 0;
+                    continue;
+                }
+                if (lastTxTimestampNs != 0 && times[i] >= lastTxTimestampNs)
+                    txGap.record(times[i] - lastTxTimestampNs);
+                lastTxTimestampNs = times[i];
+            }
+        } while (n == 64);
+    }
 
     void create(bool blocking) noexcept
     {
@@ -40,6 +303,28 @@ struct UDPConnection
         }
     }
 
+    // sends on `other`'s socket with its own batch, pacer and stats, so one thread can send
+    // while another thread receives on `other`, which owns the socket and must outlive this
+    void shareSocket(const UDPConnection& other) noexcept
+    {
+        useRpp = false;
+        c_sock = other.fd();
+        sharedSocket = true;
+    }
+
+    // lets several sockets (server shards) bind the same port, call before bind()
+    void setReusePort() noexcept
+    {
+        if (!socket_set_reuseport(fd()))
+            LogErrorExit("SO_REUSEPORT failed");
+    }
+
+    // spreads DATA packets of the reuseport group by seqid, STATUS goes to the first socket
+    bool attachSeqIdSteering(int numSockets) noexcept
+    {
+        return socket_attach_seqid_steering(fd(), numSockets);
+    }
+
     void bind(int localPort) noexcept
     {
         if (useRpp ? !socket.bind(rpp::ipaddress4{localPort})
@@ -47,25 +332,198 @@ struct UDPConnection
             LogErrorExit("server bind port=%d failed", localPort);
     }
 
+    // blocks until the rate limiter allows `pktlen` more bytes
+    void waitToSend(int pktlen) noexcept
+    {
+        PROFILE_SCOPE(PACER);
+        if (pacing == Pacing::USER)
+            pacer.waitToSend(pktlen);
+        else if (pacing == Pacing::TXTIME)
+            nextTxTimeNs = pacer.schedule(pktlen);
+        // Pacing::KERNEL: the socket's SO_MAX_PACING_RATE does it all
+    }
+
     bool sendPacketTo(const Packet& pkt, int pktlen, const rpp::ipaddress& to) noexcept
     {
-        if (balancer.get_max_bytes_per_sec() != 0)
-            balancer.wait_to_send(pktlen);
+        waitToSend(pktlen);
+        return sendPacketNow(pkt, pktlen, to);
+    }
 
-        int r = useRpp
-              ? socket.sendto(to, &pkt, pktlen)
-              : socket_sendto(c_sock, &pkt, pktlen, to.Address.Addr4, to.Port);
+    // sends without rate limiting, caller is expected to waitToSend() first
+    bool sendPacketNow(const Packet& pkt, int pktlen, const rpp::ipaddress& to) noexcept
+    {
+        if (useTxMsgs())
+            return queuePacketTo(pkt, pktlen, to);
+
+        int64_t sendTime = timestamping ? nowNanos() : 0;
+        int r;
+        {
+            PROFILE_SCOPE(SEND);
+            r = useRpp ? socket.sendto(to, &pkt, pktlen)
+                       : socket_sendto(c_sock, &pkt, pktlen, to.Address.Addr4, to.Port);
+        }
+        ++stats.sendCalls;
         if (r <= 0) {
-            LogError(RED("sendto %s %s len:%d failed: %s"), to.str(), to_string(pkt.type), pktlen, rpp::socket::last_os_socket_err());
+            if (errno == EAGAIN || errno == EWOULDBLOCK) PROFILE_COUNT(SEND_EAGAIN);
+            HotLogError(RED("sendto %s %s len:%d failed: %s"), to, to_string(pkt.type), pktlen, LogErrno{errno});
+            return false;
+        }
+        ++stats.sent;
+        udp_msg sentMsg { const_cast<Packet*>(&pkt), pktlen, pktlen, 0, 0, 0, 0 };
+        onDatagramsSent(&sentMsg, 1, sendTime);
+        return true;
+    }
+
+    // copies the packet into the send batch, STATUS packets and full batches are flushed immediately
+    bool queuePacketTo(const Packet& pkt, int pktlen, const rpp::ipaddress& to) noexcept
+    {
+        if (pktlen > MAX_PACKET_SIZE) {
+            HotLogError(RED("sendto %s %s len:%d failed: packet too big"), to, to_string(pkt.type), pktlen);
             return false;
         }
+        if (gso && appendSegment(pkt, pktlen, to))
+            return true;
+
+        if (txCount == batchSize && !flushSends()) // full of GSO super-buffers
+            return false;
+        char* slot = &txBuffers[size_t(txCount) * txSlotSize];
+        memcpy(slot, &pkt, pktlen);
+        int gsoSize = (gso && pkt.type == PacketType::DATA) ? pktlen : 0;
+        txMsgs[txCount++] = { slot, pktlen, 0, uint32_t(to.Address.Addr4), (unsigned short)to.Port, 0, nextTxTimeNs, gsoSize };
+        nextTxTimeNs = 0;
+        if ((txCount == batchSize && !gso) || pkt.type == PacketType::STATUS)
+            return flushSends();
         return true;
     }
 
-    Packet& getReceivedPacket() noexcept { return *reinterpret_cast<Packet*>(buffer); }
+    // GSO: appends the DATA packet to the last super-buffer if it has the same size and destination
+    bool appendSegment(const Packet& pkt, int pktlen, const rpp::ipaddress& to) noexcept
+    {
+        if (txCount == 0 || pkt.type != PacketType::DATA)
+            return false;
+        udp_msg& m = txMsgs[txCount - 1];
+        if (m.gso_size != pktlen || m.addr != uint32_t(to.Address.Addr4) || m.port != to.Port ||
+            m.size + pktlen > UDP_MAX_GSO_SIZE || m.size / pktlen >= UDP_MAX_GSO_SEGMENTS)
+            return false;
+        memcpy(static_cast<char*>(m.data) + m.size, &pkt, pktlen);
+        m.size += pktlen;
+        nextTxTimeNs = 0; // the whole super-buffer leaves at the first segment's launch time
+        return true;
+    }
+
+    static int numSegments(const udp_msg& m) noexcept
+    {
+        return m.gso_size > 0 ? (m.size + m.gso_size - 1) / m.gso_size : 1;
+    }
+
+    // re-stamps our own DATA in the send batch, so the time it waited for the batch to fill isn't latency.
+    // Echoed DATA keeps the client's sendTimeNs, and the bridge forwards packets untouched.
+    void stampQueuedSendTimes() noexcept
+    {
+        int64_t now = nowNanos();
+        for (int i = 0; i < txCount; ++i) {
+            const udp_msg& m = txMsgs[i];
+            int stride = m.gso_size > 0 ? m.gso_size : m.size; // GSO: every segment is a whole packet
+            for (int offset = 0; offset < m.size; offset += stride) {
+                Packet* p = reinterpret_cast<Packet*>(static_cast<char*>(m.data) + offset);
+                if (p->type == PacketType::DATA && !p->echoed)
+                    p->sendTimeNs = now;
+            }
+        }
+    }
+
+    // sends all queued packets with as few sendmmsg calls as possible
+    // @param submit io_uring: false leaves them for the io_uring_enter which waits for data
+    bool flushSends(bool submit = true) noexcept
+    {
+        if (stampQueuedData && txCount > 0)
+            stampQueuedSendTimes();
+        if (hasEngine())
+            return flushToEngine(submit);
+        int sent = 0;
+        while (sent < txCount) {
+            int64_t sendTime = timestamping ? nowNanos() : 0;
+            int r;
+            {
+                PROFILE_SCOPE(SEND);
+                r = socket_sendmmsg(fd(), &txMsgs[sent], txCount - sent);
+            }
+            ++stats.sendCalls;
+            if (r <= 0) {
+                if (errno == EAGAIN || errno == EWOULDBLOCK) PROFILE_COUNT(SEND_EAGAIN);
+                HotLogError(RED("sendmmsg %d pkts failed: %s"), txCount - sent, LogErrno{errno});
+                txCount = 0;
+                return false;
+            }
+            for (int i = sent; i < sent + r; ++i)
+                stats.sent += numSegments(txMsgs[i]);
+            onDatagramsSent(&txMsgs[sent], r, sendTime);
+            sent += r;
+        }
+        txCount = 0;
+        return true;
+    }
+
+    int64_t engineSyscalls() const noexcept
+    {
+        return uring ? uring_udp_syscalls(uring) : xdp_udp_syscalls(xdp);
+    }
+
+    // queues the send batch as io_uring sendmsg requests or AF_XDP tx frames,
+    // they complete asynchronously
+    bool flushToEngine(bool submit) noexcept
+    {
+        PROFILE_SCOPE(SEND);
+        int64_t sendTime = timestamping ? nowNanos() : 0;
+        int64_t syscalls = engineSyscalls();
+        bool ok = true;
+        for (int i = 0; i < txCount && ok; ++i) {
+            if ((ok = uring ? uring_udp_queue_send(uring, &txMsgs[i]) : xdp_udp_queue_send(xdp, &txMsgs[i])))
+                stats.sent += numSegments(txMsgs[i]);
+        }
+        if (ok && submit && (uring ? uring_udp_submit(uring) : xdp_udp_submit(xdp)) < 0)
+            ok = false;
+        stats.sendCalls += engineSyscalls() - syscalls;
+        if (!ok)
+            HotLogError(RED("%s send %d pkts failed: %s"), engineName(engine()), txCount, LogErrno{errno});
+        onDatagramsSent(txMsgs.data(), txCount, sendTime);
+        txCount = 0;
+        return ok;
+    }
+
+    // refills the receive batch from io_uring or AF_XDP,
+    // io_uring submits queued sends with the same syscall
+    // @param timeoutMillis 0: only take what is already received, -1: wait forever
+    int recvEngine(int timeoutMillis) noexcept
+    {
+        if (txCount > 0) flushSends(/*submit*/false);
+        if (timestamping) readTxTimestamps();
+        rxCount = rxNext = rxSegOffset = 0;
+        int64_t syscalls = engineSyscalls();
+        PROFILE_SCOPE(RECV);
+        int n = uring ? uring_udp_recv(uring, rxMsgs.data(), batchSize, timeoutMillis)
+                      : xdp_udp_recv(xdp, rxMsgs.data(), batchSize, timeoutMillis);
+        rxReadTimeNs = nowNanos();
+        stats.recvCalls += engineSyscalls() - syscalls;
+        if (n < 0) {
+            HotLogError(RED("%s recv failed: %s"), engineName(engine()), LogErrno{errno});
+            return n;
+        }
+        rxCount = n;
+        return n;
+    }
+
+    Packet& getReceivedPacket() noexcept { return *received; }
 
     bool pollRead(int timeoutMillis = 0) noexcept
     {
+        if (rxNext < rxCount)
+            return true; // still have packets from the last batch
+        if (hasEngine())
+            return recvEngine(timeoutMillis) > 0; // no syscall if nothing to submit and data is ready
+        ++stats.pollCalls;
+        if (timestamping) readTxTimestamps();
+        PROFILE_SCOPE(POLL);
         return useRpp ? socket.poll(timeoutMillis, rpp::socket::PF_Read)
                       : socket_poll_recv(c_sock, timeoutMillis);
     }
@@ -79,40 +537,114 @@ struct UDPConnection
 
     int recvPacketFrom(rpp::ipaddress& from, int timeoutMillis) noexcept
     {
-        if (timeoutMillis >= 0 && !pollRead(timeoutMillis))
-            return 0; // no data available (timeout)
+        if (rxNext >= rxCount) {
+            // about to block for new data, so send out anything that is queued,
+            // io_uring submits it together with the wait for new data
+            if (txCount > 0) flushSends(/*submit*/!uring);
+            if ((timeoutMillis >= 0 || hasEngine()) && !pollRead(timeoutMillis))
+                return 0; // no data available (timeout)
+        }
 
         rpp::ipaddress sentFrom;
         int r;
-        if (useRpp) {
+        if (useRxMsgs()) {
+            r = recvBatched(sentFrom);
+        } else if (useRpp) {
+            PROFILE_SCOPE(RECV);
             r = socket.recvfrom(sentFrom, buffer, sizeof(buffer));
+            recvTimeNs = nowNanos();
+            ++stats.recvCalls;
         } else {
+            PROFILE_SCOPE(RECV);
             sentFrom.Address.Family = rpp::AF_IPv4;
             r = socket_recvfrom(c_sock, buffer, sizeof(buffer), &sentFrom.Address.Addr4, &sentFrom.Port);
+            recvTimeNs = nowNanos();
+            ++stats.recvCalls;
         }
 
         if (r <= 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) PROFILE_COUNT(RECV_EAGAIN);
             if (rpp::socket::last_os_socket_err_type() == rpp::socket::SE_CONNRESET)
                 return r; // ignore connection reset errors
-            LogError("recvfrom failed: %s", rpp::socket::last_os_socket_err());
+            HotLogError("recvfrom failed: %s", LogErrno{errno});
             return r;
         }
 
+        ++stats.received;
+
         // validate the packet
         Packet& p = getReceivedPacket();
         if ((p.type != PacketType::DATA && p.type != PacketType::STATUS) ||
             (p.type == PacketType::DATA && r != p.len) ||
             (p.type == PacketType::STATUS && r != sizeof(Packet))) {
-            LogInfo(ORANGE("recv invalid packet (size=%d) from %s: type=%d seqid=%d"),
-                    r, sentFrom.str(), int(p.type), p.seqid);
+            PROFILE_SCOPE(LOG);
+            HotLogInfo(ORANGE("recv invalid packet (size=%d) from %s: type=%d seqid=%d"),
+                       r, sentFrom, int(p.type), p.seqid);
             return -1;
         }
 
+        // not on BURST_START, its DATA follows right behind it and may already be dropped
+        // by the time we read the file, so the burst starts from the counter of the last BURST_FINISH
+        if (p.type == PacketType::STATUS && p.status != StatusType::BURST_START && rxqOvfl && !useRxMsgs()) {
+            int64_t drops = readUdpSocketDrops(fd());
+            if (drops >= 0) socketDrops.store(uint32_t(drops), std::memory_order_relaxed);
+        }
+
         // packet is OK, set `from`
         from = sentFrom;
         return r;
     }
 
+    // returns the next packet from the receive batch, refilling it with recvmmsg if needed
+    // GRO super-buffers are returned one segment at a time
+    int recvBatched(rpp::ipaddress& sentFrom) noexcept
+    {
+        if (rxNext >= rxCount && hasEngine()) {
+            int n = recvEngine(-1);
+            if (n <= 0) return n;
+        } else if (rxNext >= rxCount) {
+            rxCount = rxNext = rxSegOffset = 0;
+            int n;
+            {
+                PROFILE_SCOPE(RECV);
+                n = socket_recvmmsg(fd(), rxMsgs.data(), batchSize);
+            }
+            rxReadTimeNs = nowNanos();
+            ++stats.recvCalls;
+            if (n <= 0) return n;
+            rxCount = n;
+        }
+        udp_msg& m = rxMsgs[rxNext];
+        int len = m.len;
+        char* segment = static_cast<char*>(m.data) + rxSegOffset;
+        if (m.gso_size > 0 && m.len > m.gso_size) {
+            len = std::min(m.gso_size, m.len - rxSegOffset);
+            rxSegOffset += len;
+            if (rxSegOffset >= m.len) { ++rxNext; rxSegOffset = 0; }
+        } else {
+            ++rxNext;
+        }
+    #if !(__x86_64__ || __i386__ || __aarch64__)
+        // segments are only mtu aligned, so copy them for aligned header access
+        if (reinterpret_cast<uintptr_t>(segment) & 7) {
+            memcpy(buffer, segment, len);
+            segment = buffer;
+        }
+    #endif
+        received = reinterpret_cast<Packet*>(segment);
+        if (m.drops != 0) socketDrops.store(m.drops, std::memory_order_relaxed);
+        if (m.timestamp_ns != 0) {
+            recvTimeNs = m.timestamp_ns; // when the kernel got it, without our scheduling delays
+            rxQueueDelay.record(rxReadTimeNs - m.timestamp_ns);
+        } else {
+            recvTimeNs = rxReadTimeNs; // whole batch shares one timestamp
+        }
+        sentFrom.Address.Family = rpp::AF_IPv4;
+        sentFrom.Address.Addr4 = m.addr;
+        sentFrom.Port = m.port;
+        return len;
+    }
+
     int getBufSize(rpp::socket::buffer_option buf) const noexcept
     {
         if (useRpp) return socket.get_buf_size(buf);
@@ -0,0 +1,290 @@
+#include "udp_quality.h"
+
+// --streams N: N independent client flows, each with its own socket, thread and seqid space
+void runClientStreams(const Args& args) noexcept
+{
+    Args streamArgs = args;
+    streamArgs.bytesPerSec = args.bytesPerSec / args.streams; // 0 stays unlimited
+
+    std::vector<std::unique_ptr<UDPQuality>> streams;
+    for (int i = 0; i < args.streams; ++i) {
+        streams.emplace_back(std::make_unique<UDPQuality>(streamArgs));
+        streams.back()->streamIndex = i;
+        streams.back()->numStreams = args.streams;
+        streams.back()->open();
+    }
+
+    std::vector<std::thread> workers;
+    for (auto& stream : streams) {
+        workers.emplace_back([s=stream.get()] { s->client(); });
+    }
+    for (std::thread& t : workers) t.join();
+
+    LogInfo("\x1b[0m===========================================================");
+    int64_t totalSent = 0, totalLost = 0;
+    double sumRate = 0.0, sumRateSq = 0.0;
+    for (auto& stream : streams) {
+        UDPQuality& s = *stream;
+        int32_t sent = s.serverCh.sent;
+        int32_t lost = sent - s.serverCh.lastStatus.dataReceived;
+        double rate = s.dataSendMillis > 0 ? (s.dataBytesSent * 1000.0) / s.dataSendMillis : 0.0;
+        totalSent += sent;
+        totalLost += lost;
+        sumRate += rate;
+        sumRateSq += rate * rate;
+        LogInfo("   STREAM %d  rate:%s  sent:%dpkts  SERVER LOST: %6.2f%% %dpkts",
+                s.streamIndex, toRateLiteral(int64_t(rate)), sent, 100.0 * lost / std::max(sent, 1), lost);
+    }
+    // Jain's fairness index: 1.0 when all streams achieved the same rate
+    double fairness = sumRateSq > 0 ? (sumRate * sumRate) / (args.streams * sumRateSq) : 1.0;
+    // streams send their bursts concurrently, so the aggregate is the sum of their rates
+    LogInfo("   AGGREGATE %d streams  throughput:%s  SERVER LOST: %6.2f%% %lldpkts  fairness:%.3f",
+            args.streams, toRateLiteral(int64_t(sumRate)),
+            100.0 * totalLost / std::max<int64_t>(totalSent, 1), (long long)totalLost, fairness);
+}
+
+// --sweep and --mtu-sweep: one full test (INIT .. FINISHED) per rate, buffer size or mtu
+struct SweepPoint
+{
+    int32_t bufSize = 0;
+    int32_t rate = 0; // requested
+    int32_t mtu = 0;
+    int64_t actualRate = 0; // what the client managed to send
+    int32_t sent = 0;
+    int32_t received = 0; // by the server
+    double pps = 0.0; // sent packets per second
+    double goodput = 0.0; // bytes per second which reached the server
+    double lossPercent = 0.0;
+    bool pass = false;
+};
+
+// @param configure sets up the socket after open(), before the test starts
+template<class Func>
+static SweepPoint runSweepPoint(const Args& pointArgs, Func&& configure) noexcept
+{
+    UDPQuality q { pointArgs };
+    q.open();
+    configure(q.c);
+    q.client();
+
+    SweepPoint p;
+    p.bufSize = pointArgs.peerBufSize;
+    p.rate = pointArgs.bytesPerSec;
+    p.mtu = pointArgs.mtu;
+    double seconds = q.dataSendMillis / 1000.0;
+    p.actualRate = seconds > 0 ? int64_t(q.dataBytesSent / seconds) : 0;
+    p.sent = q.serverCh.sent;
+    p.received = q.serverCh.lastStatus.dataReceived;
+    p.pps = seconds > 0 ? p.sent / seconds : 0.0;
+    p.goodput = seconds > 0 ? double(p.received) * p.mtu / seconds : 0.0;
+    p.lossPercent = 100.0 * (p.sent - p.received) / std::max(p.sent, 1);
+    p.pass = p.sent > 0 && p.lossPercent <= pointArgs.sweepMaxLoss;
+    return p;
+}
+
+static SweepPoint runSweepPoint(const Args& args, int32_t bufSize, int32_t rate) noexcept
+{
+    Args pointArgs = args;
+    pointArgs.bytesPerSec = rate;
+    pointArgs.rcvBufSize = bufSize;
+    pointArgs.sndBufSize = bufSize;
+    pointArgs.peerBufSize = bufSize;
+    LogInfo(CYAN("SWEEP buf:%s  rate:%s"), toLiteral(bufSize), toRateLiteral(rate));
+    return runSweepPoint(pointArgs, [](UDPConnection&) {});
+}
+
+// for every buffer size, bisects the rate range on a log scale down to SWEEP_RESOLUTION,
+// then reports the highest passing rate and the smallest buffer which sustains it
+void runClientSweep(const Args& args) noexcept
+{
+    static constexpr double SWEEP_RESOLUTION = 1.05; // stop when hi/lo is within 5%
+
+    std::vector<int32_t> bufs = args.sweepBufs;
+    std::sort(bufs.begin(), bufs.end());
+    std::vector<SweepPoint> points;
+    std::vector<int32_t> maxRates; // per buffer, 0 if even sweepMinRate lost too much
+    std::vector<int64_t> actualRates; // what the client sent at maxRate, lower if the sender was the limit
+
+    auto measure = [&](int32_t buf, int32_t rate) {
+        points.push_back(runSweepPoint(args, buf, rate));
+        return points.back();
+    };
+
+    int32_t previousMax = 0;
+    int64_t previousActual = 0;
+    for (int32_t buf : bufs) {
+        int32_t maxRate = 0;
+        int64_t maxActual = 0;
+        SweepPoint top = measure(buf, args.sweepMaxRate);
+        if (top.pass) {
+            maxRate = top.rate, maxActual = top.actualRate;
+        } else {
+            // a bigger buffer sustains at least the rate of a smaller one, so start from there
+            int32_t lo = previousMax;
+            int64_t loActual = previousActual;
+            if (lo == 0) {
+                SweepPoint bottom = measure(buf, args.sweepMinRate);
+                if (bottom.pass) lo = bottom.rate, loActual = bottom.actualRate;
+            }
+            int32_t hi = args.sweepMaxRate;
+            while (lo > 0 && double(hi) / lo > SWEEP_RESOLUTION) {
+                SweepPoint mid = measure(buf, int32_t(sqrt(double(lo) * hi)));
+                if (mid.pass) lo = mid.rate, loActual = mid.actualRate;
+                else          hi = mid.rate;
+            }
+            maxRate = lo, maxActual = loActual;
+        }
+        maxRates.push_back(maxRate);
+        actualRates.push_back(maxActual);
+        previousMax = maxRate;
+        previousActual = maxActual;
+    }
+
+    int32_t bestRate = *std::max_element(maxRates.begin(), maxRates.end());
+    int32_t kneeBuf = 0;
+    for (size_t i = 0; i < bufs.size(); ++i) {
+        if (bestRate > 0 && maxRates[i] * SWEEP_RESOLUTION >= bestRate) {
+            kneeBuf = bufs[i];
+            break;
+        }
+    }
+
+    LogInfo("\x1b[0m===========================================================");
+    LogInfo("   SWEEP %s..%s  max loss:%.2f%%  points:%zu", toRateLiteral(args.sweepMinRate),
+            toRateLiteral(args.sweepMaxRate), args.sweepMaxLoss, points.size());
+    LogInfo("   %12s  %16s  %16s", "BUFFER", "MAX RATE", "ACTUAL RATE");
+    for (size_t i = 0; i < bufs.size(); ++i) {
+        if (maxRates[i] > 0) LogInfo("   %12s  %16s  %16s", toLiteral(bufs[i]), toRateLiteral(maxRates[i]),
+                                     toRateLiteral(actualRates[i]));
+        else                 LogInfo(RED("   %12s  %16s  %16s"), toLiteral(bufs[i]), "none", "-");
+    }
+    if (bestRate > 0)
+        LogInfo(GREEN("   KNEE rate:%s  smallest buffer:%s"), toRateLiteral(bestRate), toLiteral(kneeBuf));
+    else
+        LogInfo(RED("   KNEE not found, every buffer lost more than %.2f%% at %s"),
+                args.sweepMaxLoss, toRateLiteral(args.sweepMinRate));
+
+    FILE* csv = fopen(args.sweepCsv.c_str(), "w");
+    if (!csv) {
+        LogError(RED("failed to write %s: %s"), args.sweepCsv.c_str(), strerror(errno));
+        return;
+    }
+    fprintf(csv, "buf_bytes,rate_bytes_per_sec,actual_bytes_per_sec,sent,received,loss_percent,pass\n");
+    for (const SweepPoint& p : points) {
+        fprintf(csv, "%d,%d,%lld,%d,%d,%.4f,%d\n", p.bufSize, p.rate, (long long)p.actualRate,
+                p.sent, p.received, p.lossPercent, p.pass ? 1 : 0);
+    }
+    fclose(csv);
+    LogInfo("   SWEEP points written to %s", args.sweepCsv.c_str());
+}
+
+// IPv4 packets a datagram of `size` bytes is sent as, if the path MTU is known
+static int ipFragments(int32_t size, int pathMtu) noexcept
+{
+    if (pathMtu <= 0) return 1;
+    int ipPayload = size + 8; // UDP header
+    int perFragment = (pathMtu - 20) & ~7; // fragment offsets are in 8 byte units
+    return (ipPayload + perFragment - 1) / perFragment;
+}
+
+// --mtu-sweep: from RTP sized packets up past the path MTU, where IP fragmentation kicks in,
+// to find the packetisation size with the best goodput at an acceptable loss
+void runMtuSweep(const Args& args) noexcept
+{
+    int pathMtu = socket_probe_path_mtu(args.serverAddr.Address.Addr4, uint16_t(args.serverAddr.Port));
+    int maxUnfragmented = pathMtu > 0 ? pathMtu - 28 : 0; // IPv4 + UDP headers
+    if (pathMtu > 0)
+        LogInfo(CYAN("PATH MTU %d to %s, max unfragmented datagram %d bytes"), pathMtu, args.serverAddr.str(), maxUnfragmented);
+    else
+        LogError(RED("PATH MTU to %s unknown: %s"), args.serverAddr.str(), rpp::socket::last_os_socket_err());
+
+    std::vector<int32_t> sizes;
+    for (int32_t size = args.mtuSweepMin; size <= args.mtuSweepMax; size += args.mtuSweepStep)
+        sizes.push_back(size);
+    // the fragmentation cliff itself: the largest single packet and the smallest fragmented one
+    for (int32_t size : { maxUnfragmented, maxUnfragmented + 1 })
+        if (maxUnfragmented > 0 && size >= args.mtuSweepMin && size <= args.mtuSweepMax)
+            sizes.push_back(size);
+    std::sort(sizes.begin(), sizes.end());
+    sizes.erase(std::unique(sizes.begin(), sizes.end()), sizes.end());
+
+    std::vector<SweepPoint> points;
+    for (int32_t size : sizes) {
+        Args pointArgs = args;
+        pointArgs.mtu = size;
+        LogInfo(CYAN("MTU SWEEP size:%d  fragments:%d  rate:%s"), size, ipFragments(size, pathMtu),
+                toRateLiteral(args.bytesPerSec));
+        points.push_back(runSweepPoint(pointArgs, [](UDPConnection& c) {
+            if (!socket_set_dont_fragment(c.fd(), false))
+                LogError(RED("IP_MTU_DISCOVER failed, large datagrams may not fragment: %s"), rpp::socket::last_os_socket_err());
+        }));
+    }
+
+    const SweepPoint* best = nullptr;
+    for (const SweepPoint& p : points)
+        if (p.pass && (!best || p.goodput > best->goodput)) best = &p;
+
+    LogInfo("\x1b[0m===========================================================");
+    LogInfo("   MTU SWEEP %d..%d  path mtu:%d  rate:%s  max loss:%.2f%%", args.mtuSweepMin, args.mtuSweepMax,
+            pathMtu, toRateLiteral(args.bytesPerSec), args.sweepMaxLoss);
+    LogInfo("   %6s  %5s  %10s  %16s  %8s", "SIZE", "FRAGS", "PPS", "GOODPUT", "LOSS");
+    for (const SweepPoint& p : points) {
+        const char* note = p.mtu == MTU_SIZE ? "  (RTP default)" : p.mtu == maxUnfragmented ? "  (path MTU)" : "";
+        if (p.pass) LogInfo("   %6d  %5d  %10.0f  %16s  %7.2f%%%s", p.mtu, ipFragments(p.mtu, pathMtu),
+                            p.pps, toRateLiteral(int64_t(p.goodput)), p.lossPercent, note);
+        else        LogInfo(RED("   %6d  %5d  %10.0f  %16s  %7.2f%%%s"), p.mtu, ipFragments(p.mtu, pathMtu),
+                            p.pps, toRateLiteral(int64_t(p.goodput)), p.lossPercent, note);
+    }
+    if (best)
+        LogInfo(GREEN("   BEST size:%d  goodput:%s  loss:%.2f%%"), best->mtu, toRateLiteral(int64_t(best->goodput)), best->lossPercent);
+    else
+        LogInfo(RED("   BEST not found, every size lost more than %.2f%%"), args.sweepMaxLoss);
+
+    FILE* csv = fopen(args.sweepCsv.c_str(), "w");
+    if (!csv) {
+        LogError(RED("failed to write %s: %s"), args.sweepCsv.c_str(), strerror(errno));
+        return;
+    }
+    fprintf(csv, "size_bytes,fragments,path_mtu,rate_bytes_per_sec,pps,goodput_bytes_per_sec,sent,received,loss_percent,pass\n");
+    for (const SweepPoint& p : points) {
+        fprintf(csv, "%d,%d,%d,%d,%.0f,%.0f,%d,%d,%.4f,%d\n", p.mtu, ipFragments(p.mtu, pathMtu), pathMtu,
+                p.rate, p.pps, p.goodput, p.sent, p.received, p.lossPercent, p.pass ? 1 : 0);
+    }
+    fclose(csv);
+    LogInfo("   MTU SWEEP points written to %s", args.sweepCsv.c_str());
+}
+
+// --threads N: N SO_REUSEPORT sockets on the same port, each with its own thread and TrafficStatus
+void runServerShards(const Args& args) noexcept
+{
+    std::vector<std::unique_ptr<UDPQuality>> shards;
+    std::vector<UDPQuality*> peers;
+    for (int i = 0; i < args.threads; ++i) {
+        shards.emplace_back(std::make_unique<UDPQuality>(args));
+        shards.back()->open(/*reusePort*/true);
+        peers.push_back(shards.back().get());
+    }
+
+    // without steering the kernel hashes each client flow to a single shard
+    bool steered = shards[0]->c.attachSeqIdSteering(args.threads);
+    if (steered) LogInfo(CYAN("THREADS %d shards, DATA steered by seqid"), args.threads);
+    else         LogInfo(ORANGE("THREADS %d shards, seqid steering unavailable, using per-flow hashing"), args.threads);
+
+    for (int i = 0; i < args.threads; ++i) {
+        shards[i]->peers = peers;
+        shards[i]->shardIndex = i;
+        shards[i]->steered = steered;
+        shards[i]->resetTraffic();
+    }
+
+    std::vector<std::thread> workers;
+    for (int i = 1; i < args.threads; ++i) {
+        workers.emplace_back([shard=shards[i].get(), i] {
+            pinThreadToCore(i);
+            shard->server();
+        });
+    }
+    pinThreadToCore(0);
+    shards[0]->server(); // shard 0 receives all STATUS packets
+    for (std::thread& t : workers) t.join();
+}
@@ -0,0 +1,1674 @@
+#pragma once
+#include "logging.h"
+#include "utils.h"
+#include "packets.h"
+#include "sequence_window.h"
+#include "latency_histogram.h"
+#include "packet_pool.h"
+#include "udp_connection.h"
+#include "spsc_ring.h"
+#include "net_stats.h"
+#include "result_writer.h"
+#include "impairment.h"
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <algorithm> // std::sort
+#include <errno.h>
+#include <poll.h> // bridge return thread
+
+#include <rpp/timer.h>
+
+struct Args
+{
+    int32_t rcvBufSize = 0;
+    int32_t sndBufSize = 0;
+    int32_t bytesPerBurst = parseSizeLiteral("1MB");
+    int32_t bytesPerSec = 0;
+    int32_t burstBytes = 0; // pacer bucket depth, 0: one packet
+    int32_t count = 5;
+    int32_t talkback = 0; // talkback packets to send back to server
+    int32_t mtu = 1450;
+    int32_t batch = 1; // packets per sendmmsg/recvmmsg syscall
+    int32_t window = SequenceWindow::DEFAULT_CAPACITY; // seqids tracked for dup/reorder detection
+    int32_t threads = 1; // server SO_REUSEPORT shards
+    int32_t streams = 1; // client parallel flows
+    int32_t pipeline = 0; // server: ring slots between the receive and analysis threads, 0: analyse inline
+    int32_t timestamps = 0; // SO_TIMESTAMPING: 0 off (userspace clock), 1 software, 2 hardware
+    UDPConnection::Pacing pacing = UDPConnection::Pacing::USER;
+    bool gso = false; // UDP_SEGMENT send offload
+    bool gro = false; // UDP_GRO receive offload
+    UDPConnection::Engine engine = UDPConnection::Engine::POLL;
+    std::string xdpDevice; // --engine xdp: interface to attach to
+    int32_t xdpQueue = 0; // --engine xdp: NIC queue to attach to
+    rpp::ipaddress4 listenerAddr;
+    rpp::ipaddress serverAddr;
+    rpp::ipaddress bridgeForwardAddr;
+    bool blocking = true;
+    bool echo = false;
+    bool udpc = false;
+    bool is_server = false;
+    bool is_client = false;
+    bool is_bridge = false;
+
+    // client --sweep: search the highest rate with loss below sweepMaxLoss, and the smallest buffer for it
+    bool sweep = false;
+    int32_t sweepMinRate = parseSizeLiteral("1MB");
+    int32_t sweepMaxRate = parseSizeLiteral("100MB");
+    std::vector<int32_t> sweepBufs = { 256*1024, 1024*1024, 4*1024*1024, 16*1024*1024 };
+    double sweepMaxLoss = 0.1; // percent
+    std::string sweepCsv = "sweep.csv";
+    int32_t peerBufSize = 0; // client: socket buffers the server should use, 0 keeps its own
+
+    // client --mtu-sweep: one test per datagram size, fragmented by the kernel above the path MTU
+    bool mtuSweep = false;
+    int32_t mtuSweepMin = 200;
+    int32_t mtuSweepMax = 4000;
+    int32_t mtuSweepStep = 200;
+
+    // --output json|csv <file>: machine readable burst and interval records
+    std::string outputPath;
+    ResultWriter::Format outputFormat = ResultWriter::Format::JSON;
+    int32_t intervalMs = 1000;
+
+    // --duration <seconds>: one continuous stream at --rate instead of --count bursts
+    int32_t durationSec = 0;
+    ResultWriter* output = nullptr; // opened by main, shared by all streams and shards
+
+    // bridge: --loss, --delay, ... emulate a bad link between client and server
+    ImpairmentConfig impair;
+
+    bool asyncLog = false; // hot path messages are printed by a background thread
+};
+
+struct UDPQuality
+{
+    Args args;
+    std::unique_ptr<UDPConnection> ownConnection; // null for server sessions
+    UDPConnection& c;
+    EndpointType whoami = EndpointType::SERVER; // who am I?
+    EndpointType talkingTo = EndpointType::CLIENT; // who am I talking to?
+
+    int32_t statusSeqId = 0; // seqId for our status messages
+    int32_t statusIteration = 0; // which iteration of the test this is
+    int32_t burstCount = 0; // how many packets CLIENT sends in a burst
+    int32_t talkbackCount = 0; // how many packets SERVER talkbacks in a burst?
+
+    DataPacketPool dataPool; // pre-built DATA packets for sendDataPacket
+
+    // server shards (--threads), all sharing the same port, including this one
+    std::vector<UDPQuality*> peers;
+    int shardIndex = 0;
+    bool steered = false; // DATA is spread across shards by seqid
+    std::mutex trafficMutex; // guards sessions and traffic counters which are read by peer shards
+
+    // --pipeline: the receive loop only copies DATA into rxRing, rxWorker finds the session,
+    // verifies the DATA and is the only thread which updates the session's traffic stats
+    struct RxPacket {
+        rpp::ipaddress from;
+        int64_t recvTimeNs;
+        int32_t len;
+        bool echoSent; // server: the receive loop already echoed it, the worker counts it
+        alignas(8) char data[MAX_PACKET_SIZE];
+    };
+    static constexpr int PIPELINE_BATCH = 64; // packets the worker analyses per trafficMutex lock
+    std::unique_ptr<SpscRing<RxPacket>> rxRing;
+    std::thread rxWorker;
+    std::atomic<bool> rxWorkerStop { false }; // also stops bridgeReturn
+    std::atomic<bool> stopping { false }; // ends server() and bridge(), used by udp_quality_bench
+
+    // --duration --echo: how long to wait for the echo still in flight after the stream ends
+    static constexpr int64_t CONTINUOUS_ECHO_GRACE_MS = 1000;
+
+    // bridge and server sessions whose client went silent without finishing are removed after this
+    static constexpr int64_t SESSION_IDLE_TIMEOUT_NS = 60'000'000'000;
+
+    // bridge: the listener forwards client -> server, bridgeReturn server -> client
+    static constexpr int BRIDGE_FAIRNESS_PKTS = 256;
+    std::unique_ptr<UDPConnection> sendConn; // bridge: to clients, sessions: to the server
+    std::thread bridgeReturn;
+    std::unique_ptr<SpscRing<RxPacket>> returnRing; // --pipeline: server -> client copies, rxRing has the others
+    std::atomic<uint32_t> sessionsVersion { 0 }; // bumped under trafficMutex whenever sessions change
+
+    // bridge sessions: each direction is forwarded by its own thread, counters are guarded by trafficMutex
+    struct ForwardStats {
+        int64_t forwarded = 0;
+        int64_t failed = 0; // send errors, the bridge dropped these
+        LatencyHistogram latency; // received by the bridge -> handed to the kernel
+        std::vector<int64_t> pendingRecvNs; // queued in the send batch, only used by the forwarding thread
+        void clear() noexcept { forwarded = failed = 0; latency = {}; }
+    };
+    ForwardStats toServer;
+    ForwardStats toClient;
+    std::atomic<int64_t> lastClientNs { 0 }; // sessions: wall clock of the last packet from the client
+    std::unique_ptr<Impairment> impairToServer; // bridge sessions: null unless impaired in that direction
+    std::unique_ptr<Impairment> impairToClient;
+    std::atomic<bool> bridgeFinished { false }; // bridge sessions: the server sent FINISHED
+
+    // server: one session per client stream, keyed by client address
+    std::unordered_map<uint64_t, std::shared_ptr<UDPQuality>> sessions; // shared: the bridge return thread
+    UDPQuality* listener = nullptr; // for sessions: the server shard which owns this session
+    rpp::ipaddress clientAddr; // for sessions: client stream address
+    int32_t talkbackRemaining = 0;
+    bool statusOwner = false; // sessions: this shard receives the client's STATUS, so it reports the intervals
+    std::unordered_set<uint64_t> echoKeys; // listener --pipeline: copy of the session keys for the receive loop
+    uint32_t echoKeysVersion = ~0u;
+
+    // client: --streams index, also reported by the server for its sessions
+    int32_t streamIndex = 0;
+    int32_t numStreams = 1;
+    int64_t dataBytesSent = 0; // DATA bytes sent during bursts
+    double dataSendMillis = 0.0; // time spent sending bursts
+
+    // packet rate and CPU cost of the last burst, to compare --batch/--gso/--gro
+    struct BurstCost
+    {
+        int64_t packets = 0;
+        int64_t bytes = 0;
+        int64_t elapsedNs = 0;
+        int64_t cpuNs = 0;
+    };
+    BurstCost burstCost;
+    int64_t burstCpuStartNs = 0;
+
+    // drop counters at BURST_START, the summary shows what changed during the burst
+    HostNetStats hostNetStart;
+    int64_t socketDropsStart = 0;
+
+    // server: socket buffers after open(), restored when a client doesn't choose them (Packet::bufSize)
+    int32_t openRcvBuf = 0;
+    int32_t openSndBuf = 0;
+    int32_t peerBufSize = 0; // buffer size currently requested by the client, 0: our own
+
+    explicit UDPQuality(const Args& _args) noexcept
+        : args{_args}, ownConnection{std::make_unique<UDPConnection>(!_args.udpc)}, c{*ownConnection}
+    {
+        resetTraffic();
+    }
+
+    // server session for a single client stream, sharing the listener's connection
+    UDPQuality(UDPQuality& _listener, const rpp::ipaddress& _clientAddr) noexcept
+        : args{_listener.args}, c{_listener.c}, listener{&_listener}, clientAddr{_clientAddr}
+    {
+        whoami = EndpointType::SERVER;
+        talkingTo = EndpointType::CLIENT;
+        shardIndex = _listener.shardIndex;
+        steered = _listener.steered;
+        resetTraffic();
+    }
+
+    ~UDPQuality() noexcept
+    {
+        rxWorkerStop = true;
+        if (rxWorker.joinable()) rxWorker.join();
+        if (bridgeReturn.joinable()) bridgeReturn.join();
+    }
+
+    static uint64_t addressKey(const rpp::ipaddress& addr) noexcept {
+        return (uint64_t(uint32_t(addr.Address.Addr4)) << 16) | uint16_t(addr.Port);
+    }
+
+    // listener: the session of this client address, caller must hold trafficMutex.
+    // Only an INIT creates sessions, so stray DATA can't leave sessions behind.
+    UDPQuality* findSession(const rpp::ipaddress& from, bool create) noexcept {
+        PROFILE_SCOPE(SESSION);
+        auto it = sessions.find(addressKey(from));
+        if (it != sessions.end())
+            return it->second.get();
+        if (!create)
+            return nullptr;
+        auto session = std::make_shared<UDPQuality>(*this, from);
+        UDPQuality* s = session.get();
+        sessions.emplace(addressKey(from), std::move(session));
+        ++sessionsVersion;
+        return s;
+    }
+
+    int numShards() const noexcept {
+        const UDPQuality* l = listener ? listener : this;
+        return l->peers.empty() ? 1 : int(l->peers.size());
+    }
+
+    // calls fn(session) for this client's session in every server shard, locking one shard at a time
+    template<class Func>
+    void forEachShardSession(bool create, Func&& fn) noexcept {
+        if (!listener || listener->peers.empty()) {
+            fn(*this);
+            return;
+        }
+        for (UDPQuality* shard : listener->peers) {
+            std::lock_guard lock { shard->trafficMutex };
+            if (UDPQuality* s = shard->findSession(clientAddr, create))
+                fn(*s);
+        }
+    }
+
+    // calls fn(shard) for every server shard, or just the listener without --threads
+    template<class Func>
+    void forEachShard(Func&& fn) noexcept {
+        UDPQuality* l = listener ? listener : this;
+        if (l->peers.empty()) fn(*l);
+        else for (UDPQuality* shard : l->peers) fn(*shard);
+    }
+
+    // creates and configures the socket
+    void open(bool reusePort = false) noexcept
+    {
+        c.create(args.blocking);
+        if (reusePort)
+            c.setReusePort();
+        if (args.is_server || args.is_bridge)
+            c.bind(args.listenerAddr.port());
+
+        c.pacer.setBurst(args.burstBytes);
+        c.setRateLimit(args.bytesPerSec);
+        c.setBatchSize(args.batch);
+        if (args.pacing != UDPConnection::Pacing::USER) {
+            const char* mode = args.pacing == UDPConnection::Pacing::KERNEL ? "SO_MAX_PACING_RATE" : "SO_TXTIME";
+            if (c.setPacing(args.pacing))
+                LogInfo(GREEN("%s kernel pacing enabled, egress qdisc must be fq"), mode);
+            else
+                LogError(RED("%s failed, using userspace pacing: %s"), mode, rpp::socket::last_os_socket_err());
+        }
+        if (args.gso) {
+            if (c.enableGso()) LogInfo(GREEN("UDP_SEGMENT send offload enabled"));
+            else LogError(RED("UDP_SEGMENT failed: %s"), rpp::socket::last_os_socket_err());
+        }
+        if (args.gro) {
+            if (c.enableGro()) LogInfo(GREEN("UDP_GRO receive offload enabled"));
+            else LogError(RED("UDP_GRO failed: %s"), rpp::socket::last_os_socket_err());
+        }
+        if (args.timestamps > 0) {
+            bool hardware = args.timestamps == 2;
+            if (c.enableTimestamping(hardware))
+                LogInfo(GREEN("SO_TIMESTAMPING %s enabled"), hardware ? "hardware" : "software");
+            else
+                LogError(RED("SO_TIMESTAMPING %s failed, using userspace clock: %s"),
+                         hardware ? "hardware" : "software", rpp::socket::last_os_socket_err());
+        }
+        if (!c.enableRxqOvfl())
+            LogInfo(ORANGE("SO_RXQ_OVFL not supported, socket drops are not reported: %s"), rpp::socket::last_os_socket_err());
+        if (args.engine == UDPConnection::Engine::URING) {
+            if (c.enableUring()) LogInfo(GREEN("io_uring engine enabled"));
+            else LogError(RED("io_uring engine failed, using poll: %s"), rpp::socket::last_os_socket_err());
+        } else if (args.engine == UDPConnection::Engine::XDP) {
+            if (c.enableXdp(args.xdpDevice.c_str(), args.xdpQueue))
+                LogInfo(GREEN("AF_XDP engine enabled on %s queue %d: %s, %s XDP"), args.xdpDevice.c_str(), args.xdpQueue,
+                        xdp_udp_zero_copy(c.xdp) ? "zero-copy" : "copy mode",
+                        xdp_udp_native(c.xdp) ? "native" : "generic");
+            else LogError(RED("AF_XDP engine on %s queue %d failed, using poll: %s"),
+                          args.xdpDevice.c_str(), args.xdpQueue, rpp::socket::last_os_socket_err());
+        }
+
+        if (args.rcvBufSize == 0)
+            LogInfo(CYAN("RCVBUF using OS default: %s"), toLiteral(c.getBufSize(rpp::socket::BO_Recv)));
+        else c.setBufSize(rpp::socket::BO_Recv, args.rcvBufSize);
+
+        if (args.sndBufSize == 0)
+            LogInfo(CYAN("SNDBUF using OS default: %s"), toLiteral(c.getBufSize(rpp::socket::BO_Send)));
+        else c.setBufSize(rpp::socket::BO_Send, args.sndBufSize);
+        openRcvBuf = c.getBufSize(rpp::socket::BO_Recv);
+        openSndBuf = c.getBufSize(rpp::socket::BO_Send);
+    }
+
+    // listener: applies the client's socket buffer request, 0 restores our own
+    void setPeerBufSize(int32_t bufSize) noexcept {
+        if (bufSize == peerBufSize)
+            return;
+        peerBufSize = bufSize;
+        c.setBufSize(rpp::socket::BO_Recv, bufSize > 0 ? bufSize : openRcvBuf);
+        c.setBufSize(rpp::socket::BO_Send, bufSize > 0 ? bufSize : openSndBuf);
+    }
+
+    // all kinds of traffic statistics and state to find traffic bugs
+    struct TrafficStatus
+    {
+        EndpointType sender = EndpointType::UNKNOWN;
+        int32_t sent = 0; // data packets sent TO SENDER
+        int32_t received = 0; // data packets recvd FROM SENDER
+
+        int32_t outOfOrderPackets = 0; // SENDER sent X packets out of order
+        int32_t duplicatePackets = 0; // SENDER sent X duplicate packets
+        int32_t loopedPackets = 0; // SENDER saw its own data packets
+        int32_t invalidData = 0; // RECEIVER saw invalid data in the packet, so it was corrupted
+        int32_t highestSeqId = -1; // highest DATA seqid received, for per interval loss
+
+        SequenceWindow window; // received seqids FROM SENDER
+        LatencyHistogram oneWay; // SENDER -> RECEIVER transit time
+        LatencyHistogram roundTrip; // our own DATA echoed back by SENDER
+        JitterEstimator jitter; // of the one-way transit time
+
+        // DATA arrivals during the current burst, shows how the sender's pacing looks on the wire
+        LatencyHistogram arrivalGap;
+        int64_t firstArrivalNs = 0;
+        int64_t lastArrivalNs = 0;
+        int64_t arrivedBytes = 0;
+
+        void resetArrivals() noexcept { firstArrivalNs = lastArrivalNs = arrivedBytes = 0; }
+        double arrivalRate() const noexcept {
+            int64_t elapsedNs = lastArrivalNs - firstArrivalNs;
+            return elapsedNs > 0 ? arrivedBytes * 1e9 / elapsedNs : 0.0;
+        }
+        Packet lastStatus;
+    };
+
+    TrafficStatus clientCh; // traffic FROM / TO client
+    TrafficStatus serverCh; // traffic FROM / TO server
+
+    // --output: interval records are deltas against the traffic at the previous interval
+    TrafficStatus intervalBase;
+    int64_t intervalStartNs = 0; // monotonic, 0 until the first interval starts
+    int64_t nextIntervalNs = 0;
+    int64_t intervalSocketDrops = 0;
+    HostNetStats intervalHost;
+
+    // --duration: continuous test, intervals are printed and lossy ones merged into loss bursts
+    // for a server listener: nonzero once any session was continuous, so its sessions get checked
+    int32_t durationSec = 0;
+    int64_t reportStartNs = 0; // monotonic start of the first interval
+    int64_t lossBurstStartMs = 0; // wall clock, 0: no loss burst in progress
+    int64_t lossBurstEndMs = 0;
+    int64_t lossBurstLost = 0;
+    int32_t lossBursts = 0;
+    int64_t longestLossBurstMs = 0;
+    TrafficStatus unknownCh; // traffic FROM / TO unknown
+
+    void reset(const Packet& clientInit) noexcept {
+        c.stats = {};
+        c.resetTimestampStats();
+        forEachShard([](UDPQuality& shard) { if (shard.rxRing) shard.rxRing->resetStats(); });
+        // --sweep clients choose the socket buffers, unless --buf was given here
+        if (args.rcvBufSize == 0 && args.sndBufSize == 0)
+            forEachShard([&](UDPQuality& shard) { shard.setPeerBufSize(clientInit.bufSize); });
+        // peer shards echo and verify DATA of the same session, so they all restart together
+        forEachShardSession(/*create*/true, [&](UDPQuality& s) { s.resetSession(clientInit); });
+    }
+
+    void resetSession(const Packet& clientInit) noexcept {
+        args.echo = clientInit.echo != 0;
+        args.mtu = clientInit.mtu;
+        burstCount = clientInit.burstCount;
+        talkbackCount = clientInit.talkbackCount;
+        statusSeqId = 0;
+        statusIteration = clientInit.iteration;
+        streamIndex = clientInit.stream;
+        numStreams = std::max(clientInit.numStreams, 1);
+        talkbackRemaining = 0;
+        durationSec = clientInit.duration;
+        intervalStartNs = reportStartNs = lossBurstStartMs = 0;
+        lossBursts = 0;
+        longestLossBurstMs = 0;
+        // server connection is shared by all client streams, each of which gets a share of the rate
+        int32_t rateLimit = args.bytesPerSec > 0
+                          ? args.bytesPerSec : clientInit.maxBytesPerSecond * numStreams;
+        c.setRateLimit(rateLimit);
+        resetTraffic();
+    }
+
+    void resetTraffic() noexcept {
+        clientCh = { EndpointType::CLIENT };
+        serverCh = { EndpointType::SERVER };
+        unknownCh = { EndpointType::UNKNOWN };
+        for (TrafficStatus* tr : { &clientCh, &serverCh, &unknownCh }) {
+            tr->window.setCapacity(args.window);
+            if (steered) tr->window.setIdMapping(numShards(), shardIndex);
+        }
+    }
+
+    // traffic counters summed over all server shards, or just this endpoint
+    TrafficStatus sumTraffic(EndpointType which) noexcept {
+        if (!listener || listener->peers.empty())
+            return traffic(which);
+        TrafficStatus sum { which };
+        sum.lastStatus = traffic(which).lastStatus; // status is only handled by this shard
+        forEachShardSession(/*create*/false, [&](UDPQuality& s) {
+            const TrafficStatus& tr = s.traffic(which);
+            sum.sent += tr.sent;
+            sum.received += tr.received;
+            sum.outOfOrderPackets += tr.outOfOrderPackets;
+            sum.duplicatePackets += tr.duplicatePackets;
+            sum.loopedPackets += tr.loopedPackets;
+            sum.invalidData += tr.invalidData;
+            sum.highestSeqId = std::max(sum.highestSeqId, tr.highestSeqId);
+            sum.oneWay.merge(tr.oneWay);
+            sum.roundTrip.merge(tr.roundTrip);
+            // each shard only sees every Nth packet, report the worst estimate
+            if (tr.jitter.jitter > sum.jitter.jitter) sum.jitter = tr.jitter;
+            sum.arrivalGap.merge(tr.arrivalGap);
+            if (tr.firstArrivalNs && (!sum.firstArrivalNs || tr.firstArrivalNs < sum.firstArrivalNs))
+                sum.firstArrivalNs = tr.firstArrivalNs;
+            sum.lastArrivalNs = std::max(sum.lastArrivalNs, tr.lastArrivalNs);
+            sum.arrivedBytes += tr.arrivedBytes;
+        });
+        return sum;
+    }
+
+    TrafficStatus& traffic(EndpointType which) noexcept {
+        if (which == EndpointType::SERVER) return serverCh;
+        if (which == EndpointType::CLIENT) return clientCh;
+        return unknownCh;
+    }
+
+    void sendDataPacket(EndpointType toWhom, const rpp::ipaddress& toAddr) noexcept {
+        if (!dataPool.isValidFor(args.mtu))
+            dataPool.init(args.mtu); // MTU is set by the client during INIT
+
+        TrafficStatus& tr = traffic(toWhom);
+        Data& data = dataPool.get(tr.sent, whoami, args.echo);
+        c.waitToSend(args.mtu);
+        data.sendTimeNs = nowNanos(); // after the rate limiter, so pacing isn't counted as latency
+        // --batch and --gso: flushSends() stamps it again when the batch leaves
+        if (c.sendPacketNow(data, args.mtu, toAddr))
+            tr.sent++;
+    }
+
+    bool sendStatusPacket(StatusType status, const rpp::ipaddress& to) noexcept {
+        Packet st;
+        st.type = PacketType::STATUS;
+        st.status = status;
+        st.sender = whoami;
+
+        st.echo = args.echo;
+        st.seqid = statusSeqId++;
+        st.len = sizeof(Packet);
+        st.iteration = statusIteration;
+        st.burstCount = burstCount;
+        st.talkbackCount = talkbackCount;
+
+        TrafficStatus tr = sumTraffic(talkingTo);
+        st.dataSent = tr.sent;
+        st.dataReceived = tr.received;
+        st.maxBytesPerSecond = c.pacer.getRate();
+        st.mtu = args.mtu;
+        st.stream = streamIndex;
+        st.numStreams = numStreams;
+        st.bufSize = args.peerBufSize;
+        st.duration = durationSec;
+        printStatus("send", st);
+        // control packets bypass the pacer, so they don't skew the DATA pacing stats
+        return c.sendPacketNow(st, sizeof(st), to);
+    }
+
+    void printStatus(const char* recvOrSend, const Packet& p) const noexcept {
+        PROFILE_SCOPE(LOG);
+        HotLogInfo("   %s from %s STATUS it=%d %12s:   sent:%d recv:%d", recvOrSend,
+                   to_string(p.sender), p.iteration, to_string(p.status), p.dataSent, p.dataReceived);
+    }
+
+    Packet* recvStatusFrom(rpp::ipaddress& from, int timeoutMillis) noexcept {
+        int received = c.recvPacketFrom(from, timeoutMillis);
+        if (received > 0) {
+            Packet* p = &c.getReceivedPacket();
+            if (p->type != PacketType::STATUS) {
+                LogError(RED("recv STATUS invalid packet.type:%d from: %s"), int(p->type), rpp::socket::last_os_socket_err());
+                return nullptr;
+            }
+            onStatusReceived(*p);
+            return p;
+        }
+        if (received == 0) LogError(RED("recv STATUS timeout"));
+        return nullptr;
+    }
+
+    void onDataReceived(const Data& p, int64_t recvTimeNs) noexcept {
+        TrafficStatus& tr = traffic(p.sender);
+        tr.received++;
+        if (p.seqid > tr.highestSeqId) tr.highestSeqId = p.seqid;
+
+        SequenceWindow::Result r;
+        {
+            PROFILE_SCOPE(WINDOW);
+            r = tr.window.accept(p.seqid);
+        }
+        if (r == SequenceWindow::REORDERED) {
+            tr.outOfOrderPackets++;
+        } else if (r == SequenceWindow::DUPLICATE) {
+            tr.duplicatePackets++;
+        }
+        bool valid;
+        {
+            PROFILE_SCOPE(VERIFY);
+            valid = checkDataSequence(p.buffer, p.size(), p.seqid);
+        }
+        if (!valid) {
+            tr.invalidData++;
+        }
+
+        int64_t transitNs = recvTimeNs - p.sendTimeNs;
+        if (p.echoed) {
+            tr.roundTrip.record(transitNs); // our own timestamp, no clock offset
+        } else {
+            tr.oneWay.record(transitNs);
+            tr.jitter.update(transitNs);
+        }
+
+        if (tr.lastArrivalNs != 0) tr.arrivalGap.record(recvTimeNs - tr.lastArrivalNs);
+        else                       tr.firstArrivalNs = recvTimeNs;
+        tr.lastArrivalNs = recvTimeNs;
+        tr.arrivedBytes += p.len;
+    }
+
+    void onStatusReceived(Packet& p) noexcept {
+        printStatus("recv", p);
+        TrafficStatus& tr = traffic(p.sender);
+        tr.lastStatus = p;
+    }
+
+    void client() noexcept
+    {
+        PROFILE_THREAD("client", numStreams > 1 ? streamIndex : -1);
+        whoami = EndpointType::CLIENT;
+        talkingTo = EndpointType::SERVER;
+        c.stampQueuedData = true;
+        burstCount = args.bytesPerBurst / args.mtu;
+        if (args.talkback > 0) {
+            talkbackCount = args.talkback / args.mtu;
+        }
+        durationSec = args.durationSec;
+        bool continuous = durationSec > 0;
+
+        rpp::ipaddress toServer = args.serverAddr;
+        rpp::ipaddress actualServer;
+
+        if (!sendStatusPacket(StatusType::INIT, toServer))
+            LogErrorExit(RED("Failed to send INIT packet"));
+
+        // and wait for response
+        if (Packet* st = recvStatusFrom(actualServer, /*timeoutMillis*/2000)) {
+            if (st->status != StatusType::INIT) LogErrorExit(RED("Handshake failed"));
+            LogInfo(GREEN("Received HANDSHAKE: %s"), actualServer.str());
+        } else LogErrorExit(RED("Handshake failed"));
+
+        // with count=5, statusIteration will be 1,2,3,4,5
+        for (statusIteration = 1; statusIteration <= args.count; )
+        {
+            int64_t totalSize = int64_t(args.mtu) * burstCount;
+            if (continuous)
+                LogInfo(MAGENTA(">> SEND CONTINUOUS %ds  rate:%s"), durationSec, toRateLiteral(args.bytesPerSec));
+            else
+                LogInfo(MAGENTA(">> SEND BURST pkts:%d  size:%s  rate:%s"), 
+                        burstCount, toLiteral(totalSize), toRateLiteral(args.bytesPerSec));
+            sendStatusPacket(StatusType::BURST_START, actualServer);
+
+            int32_t gotTalkback = 0;
+            bool gotBurstFinish = false;
+
+            auto handleRecv = [&](Packet& p) {
+                if (p.type == PacketType::DATA) {
+                    ++gotTalkback;
+                    onDataReceived(reinterpret_cast<Data&>(p), c.recvTimeNs);
+                } else if (p.type == PacketType::STATUS) {
+                    onStatusReceived(p);
+                    if (p.status == StatusType::BURST_FINISH && p.iteration == statusIteration) {
+                        gotBurstFinish = true;
+                        LogInfo(MAGENTA(">> SEND BURST FINISHED recvd:%dpkts"), gotTalkback);
+                        printSummary(statusIteration);
+                        LogInfo("\x1b[0m|---------------------------------------------------------|");
+                    }
+                }
+            };
+            auto waitAndRecvForDuration = [&](int32_t durationMs) {
+                rpp::Timer timer { rpp::Timer::AutoStart };
+                while (!gotBurstFinish && timer.elapsed_ms() < durationMs) {
+                    if (Packet* p = c.tryRecvPacket(/*timeoutMillis*/15)) {
+                        handleRecv(*p);
+                    }
+                    maybeReportInterval();
+                }
+            };
+
+            UDPConnection::IOStats ioStart = c.stats;
+            c.pacer.resetStats();
+            snapshotDrops();
+            serverCh.resetArrivals();
+            rpp::Timer dataStart { rpp::Timer::AutoStart };
+            int64_t cpuStart = threadCpuNanos();
+            // continuous: until the deadline, or until the int32 seqids run out
+            int32_t numPackets = continuous ? INT32_MAX : burstCount;
+            int64_t endNs = Pacer::monotonicNs() + int64_t(durationSec) * 1'000'000'000;
+            int32_t j = 0;
+            for (; j < numPackets; ++j) {
+                if ((j & 63) == 0) {
+                    maybeReportInterval();
+                    if (continuous && Pacer::monotonicNs() >= endNs)
+                        break;
+                }
+                sendDataPacket(talkingTo, actualServer);
+                // since we are rate limited anyway, poll for a few packets
+                // in batch mode, only poll once the send batch has been flushed
+                if (c.hasPendingSends())
+                    continue;
+                for (int i = 0; i < 20 && c.pollRead(); ++i) {
+                    if (Packet* p = c.tryRecvPacket())
+                        handleRecv(*p);
+                }
+            }
+            c.flushSends();
+            if (continuous) {
+                if (j == numPackets) LogInfo(ORANGE(">> SEND CONTINUOUS stopped early, seqids exhausted"));
+                totalSize = int64_t(args.mtu) * j;
+            }
+            if (c.pacing != UDPConnection::Pacing::USER) {
+                LogInfo(MAGENTA(">> KERNEL PACING enqueued in %.2fms"), dataStart.elapsed_millis());
+                int32_t expectedMs = args.bytesPerSec > 0 ? int32_t(int64_t(totalSize) * 1000 / args.bytesPerSec) : 0;
+                c.waitForPacedSends(expectedMs + 1000);
+            }
+            double dataElapsedMs = dataStart.elapsed_millis();
+            int64_t actualBytesPerSec = int64_t((totalSize * 1000.0) / (dataElapsedMs));
+            UDPConnection::IOStats io = c.stats - ioStart;
+            dataBytesSent += totalSize;
+            dataSendMillis += dataElapsedMs;
+            burstCost = { totalSize / args.mtu, totalSize, int64_t(dataElapsedMs * 1e6), threadCpuNanos() - cpuStart };
+            LogInfo(MAGENTA(">> SEND ELAPSED %.2fms  actualrate:%s  recvd:%dpkts  syscalls/pkt send:%.3f recv:%.3f poll:%.3f"), 
+                    dataElapsedMs, toRateLiteral(actualBytesPerSec), gotTalkback,
+                    io.sendCallsPerPacket(), io.recvCallsPerPacket(), io.pollCallsPerPacket());
+
+            // we always wait a bit longer, just incase we are getting any bogus packets
+            // we want to be aware that we receive too many packets
+            int64_t numTalkback = talkbackCount + (args.echo ? totalSize / args.mtu : 0);
+            if (numTalkback > 0) {
+                // 64-bit: a long --duration soak echoes more than 2GB
+                int64_t expectedTalkbackBytes = numTalkback * args.mtu;
+                int64_t minTalkbackMs = (expectedTalkbackBytes * 1000) / std::max<int64_t>(actualBytesPerSec, 1);
+                // continuous: the echo arrived while sending, only what is still in flight is left
+                if (continuous) minTalkbackMs = std::min<int64_t>(minTalkbackMs, CONTINUOUS_ECHO_GRACE_MS);
+                LogInfo(MAGENTA(">> WAITING TALKBACK %lldms expected:%lldpkts"), (long long)minTalkbackMs, (long long)numTalkback);
+                waitAndRecvForDuration(int32_t(minTalkbackMs));
+            }
+
+            // wait enough time before sending a burst finish
+            rpp::sleep_ms(300);
+            LogInfo(MAGENTA(">> SEND BURST FINISH recvd:%dpkts"), gotTalkback);
+            // after we've waited enough, send BURST_FINISH
+            if (!sendStatusPacket(StatusType::BURST_FINISH, actualServer))
+                LogErrorExit(RED("Failed to send STATUS packet"));
+
+            waitAndRecvForDuration(5000);
+            if (!gotBurstFinish) {
+                LogInfo(RED("timeout waiting BURST_FINISH ACK"));
+            }
+
+            if (continuous || statusIteration == args.count)
+                break; // we're done
+            ++statusIteration;
+        }
+
+        rpp::sleep_ms(500); // wait a bit, send finish and wait for FINISHED status
+        sendStatusPacket(StatusType::FINISHED, actualServer);
+
+        if (toServer != actualServer)
+            LogInfo(ORANGE("Client connected to %s but received data from %s"), toServer.str(), actualServer.str());
+        printSummary(statusIteration);
+    }
+
+    void server() noexcept
+    {
+        PROFILE_THREAD("server", numShards() > 1 ? shardIndex : -1);
+        whoami = EndpointType::SERVER;
+        talkingTo = EndpointType::CLIENT;
+        c.stampQueuedData = true; // talkback, echoes keep the client's stamp
+        bool talkbackPending = false;
+        int64_t nextExpireNs = 0;
+        if (args.pipeline > 0)
+            startPipeline();
+
+        while (!stopping.load(std::memory_order_relaxed)) // receive packets until stopped
+        {
+            rpp::ipaddress from;
+            int timeout = talkbackPending ? 0 : 100;
+            int rcvlen = c.recvPacketFrom(from, /*timeoutMillis*/timeout);
+
+            // send talkback packets when possible
+            if (talkbackPending)
+                talkbackPending = sendTalkback();
+
+            maybeReportInterval();
+            if (int64_t now = Pacer::monotonicNs(); now >= nextExpireNs) {
+                nextExpireNs = now + 1'000'000'000;
+                expireServerSessions();
+            }
+
+            if (rcvlen <= 0)
+                continue;
+
+            Packet& p = c.getReceivedPacket();
+            if (p.type == PacketType::DATA && rxRing) {
+                pipelineData(reinterpret_cast<Data&>(p), rcvlen, from);
+            } else if (p.type == PacketType::DATA) {
+                std::lock_guard lock { trafficMutex }; // uncontended unless a peer is summing
+                if (UDPQuality* s = findSession(from, /*create*/false))
+                    s->onServerData(reinterpret_cast<Data&>(p), rcvlen);
+                else
+                    unknownCh.received++; // no INIT from this address
+            } else if (p.type == PacketType::STATUS) {
+                UDPQuality* session;
+                {
+                    std::lock_guard lock { trafficMutex };
+                    session = findSession(from, /*create*/p.status == StatusType::INIT);
+                    if (session) session->lastClientNs.store(c.recvTimeNs, std::memory_order_relaxed);
+                }
+                if (!session) {
+                    HotLogWarning("SERVER ignored %s STATUS from %s, it has no session", to_string(p.status), from);
+                    continue;
+                }
+                // status handling locks each shard on its own, so don't hold our lock here
+                drainPipelines(); // STATUS must see all the DATA received before it
+                if (session->onServerStatus(p)) {
+                    eraseSession(from);
+                } else if (session->talkbackRemaining > 0) {
+                    talkbackPending = true;
+                }
+            }
+        }
+    }
+
+    // listener: starts rxWorker, which analyses the DATA queued by this receive loop
+    void startPipeline() noexcept {
+        rxRing = makeRxRing(args.pipeline);
+        rxWorker = std::thread{[this] { pipelineWorker(); }};
+        LogInfo(CYAN("PIPELINE shard:%d ring:%d slots  size:%s"), shardIndex, rxRing->capacity,
+                toLiteral(int64_t(rxRing->capacity) * int64_t(sizeof(RxPacket))));
+    }
+
+    static std::unique_ptr<SpscRing<RxPacket>> makeRxRing(int32_t slots) noexcept {
+        auto ring = std::make_unique<SpscRing<RxPacket>>(slots);
+        if (ring->capacity == 0)
+            LogErrorExit(RED("PIPELINE failed to map %d ring slots"), slots);
+        return ring;
+    }
+
+    // listener and bridge: copies the packet into the ring, the receive timestamp is the only thing taken here
+    static void queueForAnalysis(SpscRing<RxPacket>& ring, const Packet& p, int rcvlen,
+                                 const rpp::ipaddress& from, int64_t recvTimeNs) noexcept {
+        if (RxPacket* rx = ring.beginPush()) { // full: the worker fell behind, counted in fullDrops
+            rx->from = from;
+            rx->recvTimeNs = recvTimeNs;
+            rx->len = rcvlen;
+            rx->echoSent = false;
+            memcpy(rx->data, &p, size_t(rcvlen));
+            ring.commitPush();
+        }
+    }
+
+    // listener --pipeline: DATA from the client, no lock and no session lookup on the receive loop.
+    // The client stamps its --echo into every DATA packet, so the echo doesn't need the session either.
+    void pipelineData(Data& p, int rcvlen, const rpp::ipaddress& from) noexcept {
+        RxPacket* rx = rxRing->beginPush();
+        if (!rx) return; // full: the worker fell behind, counted in fullDrops and not echoed either
+        rx->from = from;
+        rx->recvTimeNs = c.recvTimeNs;
+        rx->len = rcvlen;
+        memcpy(rx->data, &p, size_t(rcvlen));
+        rx->echoSent = p.echo && hasEchoKey(from) && echoData(p, rcvlen, from);
+        rxRing->commitPush();
+    }
+
+    // listener --pipeline: whether `from` has a session, the receive loop only locks when sessions changed
+    bool hasEchoKey(const rpp::ipaddress& from) noexcept {
+        if (echoKeysVersion != sessionsVersion.load(std::memory_order_acquire)) {
+            std::lock_guard lock { trafficMutex };
+            echoKeysVersion = sessionsVersion.load(std::memory_order_relaxed);
+            echoKeys.clear();
+            for (auto& [key, s] : sessions) echoKeys.insert(key);
+        }
+        return echoKeys.count(addressKey(from)) != 0;
+    }
+
+    void pipelineWorker() noexcept {
+        PROFILE_THREAD("pipeline", numShards() > 1 ? shardIndex : -1);
+        int idleSpins = 0;
+        while (!rxWorkerStop.load(std::memory_order_relaxed)) {
+            if (!rxRing->front()) {
+                spscIdleWait(idleSpins);
+                continue;
+            }
+            idleSpins = 0;
+            // status and summary readers wait for one batch at most, the receive loop never waits
+            std::lock_guard lock { trafficMutex };
+            UDPQuality* s = nullptr;
+            for (int n = 0; n < PIPELINE_BATCH; ++n) {
+                RxPacket* rx = rxRing->front();
+                if (!rx) break;
+                if (!s || s->clientAddr != rx->from) // consecutive packets are usually from the same client
+                    s = findSession(rx->from, /*create*/false);
+                if (s) {
+                    s->lastClientNs.store(rx->recvTimeNs, std::memory_order_relaxed);
+                    s->onDataReceived(*reinterpret_cast<const Data*>(rx->data), rx->recvTimeNs);
+                    if (rx->echoSent) s->clientCh.sent++;
+                } else {
+                    unknownCh.received++; // no INIT from this address
+                }
+                rxRing->pop();
+            }
+        }
+    }
+
+    // listener: waits until every shard's worker has analysed its queued DATA
+    void drainPipelines() noexcept {
+        forEachShard([](UDPQuality& shard) {
+            if (shard.rxRing && !shard.rxRing->drain(/*timeoutNs*/1'000'000'000))
+                LogInfo(ORANGE("PIPELINE shard:%d worker still behind, %d packets queued"),
+                        shard.shardIndex, shard.rxRing->size());
+        });
+    }
+
+    // listener: removes a finished client session from every shard
+    void eraseSession(const rpp::ipaddress& from) noexcept {
+        if (peers.empty()) {
+            std::lock_guard lock { trafficMutex };
+            if (sessions.erase(addressKey(from))) ++sessionsVersion;
+            return;
+        }
+        for (UDPQuality* shard : peers) {
+            std::lock_guard lock { shard->trafficMutex };
+            if (shard->sessions.erase(addressKey(from))) ++shard->sessionsVersion;
+        }
+    }
+
+    // listener: removes the sessions whose client went silent without FINISHED, e.g. it crashed.
+    // DATA may arrive on any shard, so a session is idle only if it's idle in all of them.
+    void expireServerSessions() noexcept {
+        int64_t idleBefore = nowNanos() - SESSION_IDLE_TIMEOUT_NS;
+        // other shards insert sessions here, but only this thread erases the ones it owns
+        std::vector<UDPQuality*> owned;
+        {
+            std::lock_guard lock { trafficMutex };
+            for (auto& [key, s] : sessions)
+                if (s->statusOwner) owned.push_back(s.get());
+        }
+        for (UDPQuality* s : owned) {
+            int64_t lastNs = 0;
+            s->forEachShardSession(/*create*/false, [&](UDPQuality& shardSession) {
+                lastNs = std::max(lastNs, shardSession.lastClientNs.load(std::memory_order_relaxed));
+            });
+            if (lastNs < idleBefore) {
+                LogInfo(ORANGE("   SESSION %s timed out, no packets for %llds"), s->clientAddr.str(),
+                        (long long)(SESSION_IDLE_TIMEOUT_NS / 1'000'000'000));
+                eraseSession(s->clientAddr);
+            }
+        }
+    }
+
+    // listener: sends one talkback packet for every session which still has some
+    // @return true if any talkback is still pending
+    bool sendTalkback() noexcept {
+        std::lock_guard lock { trafficMutex };
+        bool pending = false;
+        for (auto& [key, s] : sessions) {
+            if (s->talkbackRemaining > 0) {
+                s->sendDataPacket(talkingTo, s->clientAddr);
+                pending |= --s->talkbackRemaining > 0;
+            }
+        }
+        return pending;
+    }
+
+    // session: DATA from the client, without --pipeline
+    void onServerData(Data& p, int rcvlen) noexcept {
+        lastClientNs.store(c.recvTimeNs, std::memory_order_relaxed);
+        onDataReceived(p, c.recvTimeNs);
+        if (args.echo && echoData(p, rcvlen, clientAddr))
+            clientCh.sent++;
+    }
+
+    // server: sends the client's DATA back to it
+    bool echoData(Data& p, int rcvlen, const rpp::ipaddress& to) noexcept {
+        p.sender = whoami; // server echoing it now
+        p.echoed = 1; // keeps the client's sendTimeNs for round-trip time
+        if (c.sendPacketTo(p, rcvlen, to))
+            return true;
+        LogInfo(ORANGE("Failed to echo packet: %d"), p.seqid);
+        return false;
+    }
+
+    // session: STATUS from the client
+    // @return true if the client finished and this session can be removed
+    bool onServerStatus(Packet& p) noexcept {
+        if (p.status == StatusType::INIT) { // Client is initializing a new session
+            LogInfo("\x1b[0m===========================================================");
+            reset(p); // RESET before updating traffic stats
+            statusOwner = true;
+            if (durationSec > 0) listener->durationSec = durationSec;
+            onStatusReceived(p);
+            sendStatusPacket(StatusType::INIT, clientAddr); // echo back the init handshake
+            LogInfo("   STARTED it=%d: %s  stream:%d/%d  rate:%s  rcvbuf:%s  sndbuf:%s", 
+                    p.iteration, clientAddr.str(), streamIndex, numStreams,
+                    toRateLiteral(c.getRateLimit()), 
+                    toLiteral(c.getBufSize(rpp::socket::BO_Recv)),
+                    toLiteral(c.getBufSize(rpp::socket::BO_Send)));
+        } else if (p.status == StatusType::BURST_START) {
+            LogInfo("\x1b[0m|---------------------------------------------------------|");
+            onStatusReceived(p);
+            statusIteration = p.iteration;
+            c.pacer.resetStats();
+            forEachShard([](UDPQuality& shard) { if (shard.rxRing) shard.rxRing->resetStats(); });
+            snapshotDrops();
+            burstCpuStartNs = processCpuNanos(); // all shard threads work on this burst
+            forEachShardSession(/*create*/false, [&](UDPQuality& s) { s.traffic(talkingTo).resetArrivals(); });
+            if (talkbackCount > 0) {
+                LogInfo("   SEND TALKBACK pkts:%d  size:%s  rate:%s", 
+                    talkbackCount, toLiteral(talkbackCount*args.mtu),
+                    toRateLiteral(c.getRateLimit()));
+            }
+            sendStatusPacket(StatusType::BURST_START, clientAddr);
+            std::lock_guard lock { listener->trafficMutex }; // talkback is sent by the listener loop
+            talkbackRemaining = talkbackCount;
+        } else if (p.status == StatusType::BURST_FINISH) {
+            onStatusReceived(p);
+            TrafficStatus client = sumTraffic(talkingTo);
+            burstCost = { client.arrivedBytes / std::max(args.mtu, 1), client.arrivedBytes,
+                          client.lastArrivalNs - client.firstArrivalNs, processCpuNanos() - burstCpuStartNs };
+            sendStatusPacket(StatusType::BURST_FINISH, clientAddr);
+            printSummary(statusIteration);
+        } else if (p.status == StatusType::FINISHED) {
+            onStatusReceived(p);
+            sendStatusPacket(StatusType::FINISHED, clientAddr); // echo back the finished handshake
+            printSummary(statusIteration);
+            LogInfo("\x1b[0m===========================================================");
+            return true;
+        }
+        return false;
+    }
+
+    // bridge: forwards between any number of clients and the server. Every client stream gets its
+    // own session socket towards the server, so replies can be routed back to the right client.
+    // This thread forwards client -> server, bridgeReturn forwards server -> client,
+    // and with --pipeline the analysis runs on rxWorker, off the forwarding path.
+    void bridge()
+    {
+        PROFILE_THREAD("bridge");
+        whoami = EndpointType::BRIDGE;
+        talkingTo = EndpointType::UNKNOWN;
+        sendConn = makeSendConnection(c); // the return thread sends to clients on our listen socket
+        if (args.pipeline > 0) {
+            rxRing = makeRxRing(args.pipeline);
+            returnRing = makeRxRing(args.pipeline);
+            rxWorker = std::thread{[this] { bridgeAnalysisWorker(); }};
+            LogInfo(CYAN("PIPELINE bridge analysis ring:%d slots per direction"), rxRing->capacity);
+        }
+        bridgeReturn = std::thread{[this] { bridgeReturnLoop(); }};
+
+        std::vector<UDPQuality*> unflushed; // sessions with queued sends
+        int64_t nextExpireNs = 0;
+        int timeoutMillis = 100; // shorter while impaired packets are waiting
+        while (!stopping.load(std::memory_order_relaxed))
+        {
+            rpp::ipaddress from;
+            int recvlen = c.recvPacketFrom(from, timeoutMillis);
+            if (recvlen > 0) {
+                Packet& p = c.getReceivedPacket();
+                if (p.sender == EndpointType::CLIENT) {
+                    UDPQuality* s = bridgeSession(from);
+                    if (p.type == PacketType::STATUS && p.status == StatusType::INIT)
+                        s->resetForwarding();
+                    s->lastClientNs.store(c.recvTimeNs, std::memory_order_relaxed);
+                    if (rxRing) queueForAnalysis(*rxRing, p, recvlen, from, c.recvTimeNs);
+                    if (s->impairToServer)
+                        s->impairToServer->submit(p, recvlen, c.recvTimeNs, Pacer::monotonicNs());
+                    else if (s->forward(*s->sendConn, s->toServer, p, recvlen, args.bridgeForwardAddr, c.recvTimeNs))
+                        unflushed.push_back(s);
+                } else {
+                    HotLogWarning("BRIDGE ignored %s packet from %s, servers reply to session sockets",
+                                  to_string(p.sender), from);
+                }
+            }
+            // flush once the receive batch is used up, the next receive will be a syscall
+            if (c.rxNext >= c.rxCount) {
+                int64_t now = Pacer::monotonicNs();
+                if (args.impair.toServer && args.impair.enabled()) {
+                    int64_t nextDueNs = INT64_MAX;
+                    for (auto& [key, s] : sessions) {
+                        if (!s->impairToServer) continue;
+                        if (s->releaseImpaired(*s->impairToServer, *s->sendConn, s->toServer, args.bridgeForwardAddr, now))
+                            unflushed.push_back(s.get());
+                        nextDueNs = std::min(nextDueNs, s->impairToServer->nextDueNs());
+                    }
+                    timeoutMillis = impairedTimeoutMillis(nextDueNs, now, 100);
+                }
+                for (UDPQuality* s : unflushed) s->flushForwarded(*s->sendConn, s->toServer);
+                unflushed.clear();
+                if (now >= nextExpireNs) {
+                    nextExpireNs = now + 1'000'000'000;
+                    expireBridgeSessions();
+                }
+            }
+        }
+    }
+
+    // bridge: a connection which sends on `owner`'s socket from another thread
+    std::unique_ptr<UDPConnection> makeSendConnection(const UDPConnection& owner) const noexcept {
+        auto conn = std::make_unique<UDPConnection>(/*useRpp*/false);
+        conn->shareSocket(owner);
+        conn->setBatchSize(args.batch);
+        conn->setRateLimit(args.bytesPerSec); // --rate on the bridge still limits it
+        return conn;
+    }
+
+    // bridge: the session of a client stream, the first packet opens its socket towards the server,
+    // only this thread adds or removes sessions
+    UDPQuality* bridgeSession(const rpp::ipaddress& from) noexcept {
+        auto it = sessions.find(addressKey(from));
+        if (it != sessions.end())
+            return it->second.get();
+        Args sessionArgs = args;
+        sessionArgs.is_bridge = false; // ephemeral port, the server replies to it
+        sessionArgs.engine = UDPConnection::Engine::POLL;
+        auto session = std::make_shared<UDPQuality>(sessionArgs);
+        session->open();
+        session->whoami = EndpointType::BRIDGE;
+        session->talkingTo = EndpointType::UNKNOWN;
+        session->clientAddr = from;
+        session->sendConn = makeSendConnection(session->c);
+        if (args.impair.enabled()) {
+            uint64_t seed = uint64_t(nowNanos()) ^ (addressKey(from) * 0x9E3779B97F4A7C15ull);
+            if (args.impair.toServer) session->impairToServer = std::make_unique<Impairment>(args.impair, seed);
+            if (args.impair.toClient) session->impairToClient = std::make_unique<Impairment>(args.impair, ~seed);
+        }
+        UDPQuality* s = session.get();
+        {
+            std::lock_guard lock { trafficMutex };
+            sessions.emplace(addressKey(from), std::move(session));
+            ++sessionsVersion;
+        }
+        LogInfo("   BRIDGE session %s -> server %s  sessions:%zu", from.str(), args.bridgeForwardAddr.str(), sessions.size());
+        return s;
+    }
+
+    // bridge: removes sessions which finished, or whose client went silent
+    void expireBridgeSessions() noexcept {
+        int64_t idleBefore = nowNanos() - SESSION_IDLE_TIMEOUT_NS;
+        std::lock_guard lock { trafficMutex };
+        for (auto it = sessions.begin(); it != sessions.end(); ) {
+            UDPQuality& s = *it->second;
+            bool finished = s.bridgeFinished.load(std::memory_order_relaxed);
+            if (finished || s.lastClientNs.load(std::memory_order_relaxed) < idleBefore) {
+                LogInfo("   BRIDGE session %s %s", s.clientAddr.str(), finished ? "finished" : "timed out");
+                it = sessions.erase(it); // the return thread keeps its own reference until it notices
+                ++sessionsVersion;
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    // bridge: forwards server -> client for every session, batched per session
+    void bridgeReturnLoop() noexcept {
+        PROFILE_THREAD("return");
+        std::vector<std::shared_ptr<UDPQuality>> active;
+        std::vector<pollfd> fds;
+        uint32_t version = ~0u;
+        int timeoutMillis = 100; // shorter while impaired packets are waiting
+        while (!rxWorkerStop.load(std::memory_order_relaxed)) {
+            {
+                std::lock_guard lock { trafficMutex };
+                if (version != sessionsVersion) {
+                    version = sessionsVersion;
+                    active.clear();
+                    fds.clear();
+                    for (auto& [key, s] : sessions) {
+                        active.push_back(s);
+                        fds.push_back({ s->c.fd(), POLLIN, 0 });
+                    }
+                }
+            }
+            if (active.empty()) {
+                rpp::sleep_ms(10);
+                continue;
+            }
+            bool readable = poll(fds.data(), fds.size(), timeoutMillis) > 0;
+            for (size_t i = 0; readable && i < active.size(); ++i) {
+                if (!(fds[i].revents & POLLIN))
+                    continue;
+                UDPQuality& s = *active[i];
+                bool queued = false;
+                // at most a few batches, then the other sessions get their turn
+                for (int n = 0; n < BRIDGE_FAIRNESS_PKTS; ++n) {
+                    rpp::ipaddress from;
+                    int recvlen = s.c.recvPacketFrom(from, /*timeoutMillis*/0);
+                    if (recvlen <= 0)
+                        break;
+                    Packet& p = s.c.getReceivedPacket();
+                    if (returnRing) queueForAnalysis(*returnRing, p, recvlen, s.clientAddr, s.c.recvTimeNs);
+                    if (s.impairToClient) {
+                        s.impairToClient->submit(p, recvlen, s.c.recvTimeNs, Pacer::monotonicNs());
+                        continue;
+                    }
+                    queued |= s.forward(*sendConn, s.toClient, p, recvlen, s.clientAddr, s.c.recvTimeNs);
+                    if (p.type == PacketType::STATUS)
+                        s.onBridgeServerStatus(p, returnRing != nullptr, c.socketDrops.load(std::memory_order_relaxed));
+                }
+                if (queued) s.flushForwarded(*sendConn, s.toClient);
+            }
+            if (args.impair.toClient && args.impair.enabled()) {
+                int64_t now = Pacer::monotonicNs();
+                int64_t nextDueNs = INT64_MAX;
+                for (auto& s : active) {
+                    if (!s->impairToClient) continue;
+                    if (s->releaseImpaired(*s->impairToClient, *sendConn, s->toClient, s->clientAddr, now, this))
+                        s->flushForwarded(*sendConn, s->toClient);
+                    nextDueNs = std::min(nextDueNs, s->impairToClient->nextDueNs());
+                }
+                timeoutMillis = impairedTimeoutMillis(nextDueNs, now, 100);
+            }
+        }
+    }
+
+    // bridge session: STATUS from the server, after it was forwarded to the client
+    void onBridgeServerStatus(const Packet& p, bool analysed, uint32_t listenDrops) noexcept {
+        bool finished = p.status == StatusType::FINISHED;
+        if (!analysed && (finished || p.status == StatusType::BURST_FINISH)) {
+            std::lock_guard lock { trafficMutex };
+            printForwardStats(listenDrops);
+        }
+        if (finished)
+            bridgeFinished = true; // the client side thread removes the session
+    }
+
+    // bridge session: sends on `out`, latency is recorded when the batch leaves
+    // @return true if the packet is still queued in `out` and needs flushForwarded()
+    bool forward(UDPConnection& out, ForwardStats& fs, const Packet& p, int len,
+                 const rpp::ipaddress& to, int64_t recvTimeNs) noexcept {
+        if (args.bytesPerSec > 0) out.waitToSend(len);
+        fs.pendingRecvNs.push_back(recvTimeNs);
+        bool ok = out.sendPacketNow(p, len, to);
+        if (ok && out.txCount > 0)
+            return true;
+        onForwarded(fs, ok); // sent right away, or the batch filled up and was sent
+        return false;
+    }
+
+    // bridge session: forwards the impaired packets which are due by nowNs,
+    // towards the client a server STATUS is only handled once it actually leaves
+    // @return true if some are still queued in `out` and need flushForwarded()
+    bool releaseImpaired(Impairment& imp, UDPConnection& out, ForwardStats& fs, const rpp::ipaddress& to,
+                         int64_t nowNs, const UDPQuality* returningBridge = nullptr) noexcept {
+        bool queued = false;
+        imp.release(nowNs, [&](const Packet& p, int len, int64_t recvTimeNs) {
+            queued |= forward(out, fs, p, len, to, recvTimeNs);
+            if (returningBridge && p.type == PacketType::STATUS) {
+                if (queued) flushForwarded(out, fs), queued = false;
+                onBridgeServerStatus(p, returningBridge->returnRing != nullptr,
+                                     returningBridge->c.socketDrops.load(std::memory_order_relaxed));
+            }
+        });
+        return queued;
+    }
+
+    // bridge: waits at most until the next impaired packet is due, rounded up to the poll resolution
+    static int impairedTimeoutMillis(int64_t nextDueNs, int64_t nowNs, int maxMillis) noexcept {
+        if (nextDueNs == INT64_MAX)
+            return maxMillis;
+        int64_t waitNs = nextDueNs - nowNs;
+        if (waitNs <= 0)
+            return 0;
+        return int(std::min<int64_t>(maxMillis, (waitNs + 999'999) / 1'000'000));
+    }
+
+    void flushForwarded(UDPConnection& out, ForwardStats& fs) noexcept {
+        if (!fs.pendingRecvNs.empty())
+            onForwarded(fs, out.flushSends());
+    }
+
+    void onForwarded(ForwardStats& fs, bool ok) noexcept {
+        int64_t now = nowNanos();
+        std::lock_guard lock { trafficMutex }; // read by whoever prints the session
+        if (ok) {
+            fs.forwarded += int64_t(fs.pendingRecvNs.size());
+            for (int64_t recvTimeNs : fs.pendingRecvNs) fs.latency.record(now - recvTimeNs);
+        } else {
+            fs.failed += int64_t(fs.pendingRecvNs.size());
+        }
+        fs.pendingRecvNs.clear();
+    }
+
+    // bridge session: a new test from the same client port
+    void resetForwarding() noexcept {
+        std::lock_guard lock { trafficMutex };
+        toServer.clear();
+        toClient.clear();
+        if (impairToServer) impairToServer->counters.clear();
+        if (impairToClient) impairToClient->counters.clear();
+        bridgeFinished = false;
+    }
+
+    // bridge session, caller holds trafficMutex
+    void printForwardStats(uint32_t listenDrops) noexcept {
+        LogInfo("   BRIDGE %s  to server:%lld failed:%lld  to client:%lld failed:%lld",
+                clientAddr.str(), (long long)toServer.forwarded, (long long)toServer.failed,
+                (long long)toClient.forwarded, (long long)toClient.failed);
+        uint32_t sessionDrops = c.socketDrops.load(std::memory_order_relaxed);
+        if (listenDrops > 0 || sessionDrops > 0)
+            LogInfo(RED("   BRIDGE SOCKET DROPS listen socket:%u (all clients)  session socket:%u"), listenDrops, sessionDrops);
+        toServer.latency.print("CLIENT -> SERVER", "FORWARDING");
+        toClient.latency.print("SERVER -> CLIENT", "FORWARDING");
+        if (impairToServer) printImpairment("CLIENT -> SERVER", impairToServer->counters);
+        if (impairToClient) printImpairment("SERVER -> CLIENT", impairToClient->counters);
+        PROFILE_PRINT();
+    }
+
+    // the ground truth for the receiver's loss, duplicate, reorder and invalid data counters
+    static void printImpairment(const char* direction, const Impairment::Counters& ic) noexcept {
+        auto get = [](const std::atomic<int64_t>& counter) { return (long long)counter.load(std::memory_order_relaxed); };
+        LogInfo(MAGENTA("   IMPAIRED %s DATA:%lld lost:%lld overflow:%lld duplicated:%lld corrupted:%lld reordered:%lld"),
+                direction, get(ic.data), get(ic.lost), get(ic.overflow), get(ic.duplicated), get(ic.corrupted), get(ic.reordered));
+    }
+
+    // bridge --pipeline: analyses copies of the forwarded packets, client -> server first,
+    // so a server STATUS is only handled after the DATA which was forwarded before it
+    void bridgeAnalysisWorker() noexcept {
+        PROFILE_THREAD("analysis");
+        int idleSpins = 0;
+        while (!rxWorkerStop.load(std::memory_order_relaxed)) {
+            RxPacket* rx = rxRing->front();
+            SpscRing<RxPacket>* ring = rxRing.get();
+            if (!rx) {
+                rx = returnRing->front();
+                ring = returnRing.get();
+            }
+            if (!rx) {
+                spscIdleWait(idleSpins);
+                continue;
+            }
+            idleSpins = 0;
+            std::shared_ptr<UDPQuality> s;
+            {
+                std::lock_guard lock { trafficMutex };
+                auto it = sessions.find(addressKey(rx->from));
+                if (it != sessions.end()) s = it->second;
+            }
+            if (s) s->analyseBridged(*reinterpret_cast<Packet*>(rx->data), rx->recvTimeNs,
+                                     c.socketDrops.load(std::memory_order_relaxed));
+            ring->pop();
+        }
+    }
+
+    // bridge session --pipeline: the statistics of the old inline bridge, on the analysis worker
+    void analyseBridged(Packet& p, int64_t recvTimeNs, uint32_t listenDrops) noexcept {
+        std::lock_guard lock { trafficMutex };
+        if (p.type == PacketType::DATA) {
+            onDataReceived(reinterpret_cast<Data&>(p), recvTimeNs);
+            traffic(p.sender == EndpointType::CLIENT ? EndpointType::SERVER : EndpointType::CLIENT).sent++;
+            return;
+        }
+        bool print = false;
+        if (p.sender == EndpointType::CLIENT && p.status == StatusType::INIT) {
+            resetSession(p);
+        } else if (p.sender == EndpointType::SERVER) {
+            if (p.status == StatusType::BURST_START) statusIteration = p.iteration;
+            print = p.status == StatusType::BURST_FINISH || p.status == StatusType::FINISHED;
+        }
+        onStatusReceived(p);
+        if (print) {
+            printSummary(statusIteration);
+            printForwardStats(listenDrops);
+        }
+    }
+
+    void printSummary(int iteration) noexcept
+    {
+        AsyncLog::flush(); // the STATUS lines of this burst come first
+        if (whoami == EndpointType::CLIENT) {
+            // server must have received all the packets that client sent
+            printReceivedAt("SERVER", /*expected*/serverCh.sent, /*actual*/serverCh.lastStatus.dataReceived, serverCh.invalidData);
+
+            // we must know how many packets SERVER should send back to us
+            int32_t expectedFromServer = (args.echo ? serverCh.sent : 0) + talkbackCount*iteration;
+            if (expectedFromServer > 0) {
+                printReceivedAt("CLIENT", expectedFromServer, serverCh.received, clientCh.invalidData);
+            }
+            DropCounts drops = dropsSince(socketDropsStart, hostNetStart);
+            printDrops(drops);
+            if (args.output) {
+                ResultRecord r = makeRecord("burst", serverCh, drops);
+                r.setExpected(expectedFromServer);
+                r.peerReceived = serverCh.lastStatus.dataReceived;
+                args.output->write(r);
+            }
+            if (durationSec > 0) printLossBursts();
+            printBurstCost("CLIENT SEND");
+            serverCh.roundTrip.print("ROUND TRIP");
+            printLatency("SERVER -> CLIENT", serverCh);
+        } else if (whoami == EndpointType::SERVER) {
+            if (numStreams > 1)
+                LogInfo("   STREAM %d/%d  %s", streamIndex, numStreams, clientAddr.str());
+            TrafficStatus client = sumTraffic(EndpointType::CLIENT);
+            // server must have received all the packets that client sent
+            printReceivedAt("SERVER", /*expected*/client.lastStatus.dataSent, /*actual*/client.received, client.invalidData);
+
+            // client must have received all the packets that it sent + talkback
+            int32_t expectedAtClient = 0;
+            if (args.echo) expectedAtClient = client.lastStatus.dataSent;
+            if (talkbackCount > 0) expectedAtClient += talkbackCount*iteration;
+            if (expectedAtClient > 0) {
+                printReceivedAt("CLIENT", expectedAtClient, client.lastStatus.dataReceived, client.invalidData);
+            }
+            DropCounts drops = dropsSince(socketDropsStart, hostNetStart);
+            printDrops(drops);
+            printUnknownData();
+            if (args.output) {
+                ResultRecord r = makeRecord("burst", client, drops);
+                r.setExpected(client.lastStatus.dataSent);
+                r.peerReceived = client.lastStatus.dataReceived;
+                args.output->write(r);
+            }
+            if (durationSec > 0) printLossBursts();
+            printBurstCost("SERVER RECV");
+            printLatency("CLIENT -> SERVER", client);
+        } else if (whoami == EndpointType::BRIDGE) {
+            // we should have forwarded everything that CLIENT sent
+            printReceivedAt("CLIENT -> BRIDGE", clientCh.lastStatus.dataSent, clientCh.received, clientCh.invalidData);
+            // we should have forwarded everything that SERVER sent
+            printReceivedAt("SERVER -> BRIDGE", serverCh.lastStatus.dataSent, serverCh.received, serverCh.invalidData);
+            printLatency("CLIENT -> BRIDGE", clientCh);
+            printLatency("SERVER -> BRIDGE", serverCh);
+        }
+
+        if (numShards() > 1) {
+            int32_t expected = traffic(talkingTo).lastStatus.dataSent;
+            forEachShardSession(/*create*/false, [&](UDPQuality& s) {
+                const TrafficStatus& tr = s.traffic(talkingTo);
+                LogInfo("   SHARD %d recv:%d  echo:%d", s.shardIndex, tr.received, tr.sent);
+                tr.window.printErrors(expected);
+                tr.window.printLossModel(expected);
+            });
+        } else if (whoami == EndpointType::SERVER || whoami == EndpointType::CLIENT) {
+            const TrafficStatus& tr = traffic(talkingTo);
+            // server echo reuses CLIENT seqids while talkback counts its own, so with both
+            // the seqids received by CLIENT are not a simple [0, dataSent) range
+            bool mixedSeqIds = whoami == EndpointType::CLIENT && args.echo && talkbackCount > 0;
+            tr.window.printErrors(mixedSeqIds ? 0 : tr.lastStatus.dataSent);
+            tr.window.printLossModel(mixedSeqIds ? 0 : tr.lastStatus.dataSent);
+        }
+        printIOStats();
+        if (whoami == EndpointType::SERVER)
+            printPipelineStats();
+    }
+
+    // SO_RXQ_OVFL drops summed over all server shards, or just this socket
+    int64_t sumSocketDrops() noexcept {
+        int64_t drops = 0;
+        forEachShard([&](UDPQuality& shard) { drops += shard.c.socketDrops.load(std::memory_order_relaxed); });
+        return drops;
+    }
+
+    void snapshotDrops() noexcept {
+        hostNetStart = HostNetStats::read();
+        socketDropsStart = sumSocketDrops();
+    }
+
+    struct DropCounts {
+        int64_t socket = 0;
+        HostNetStats host;
+    };
+
+    DropCounts dropsSince(int64_t socketBase, const HostNetStats& hostBase) noexcept {
+        return { sumSocketDrops() - socketBase, HostNetStats::read() - hostBase };
+    }
+
+    // where packets died on this host during the burst, next to the loss the application saw
+    void printDrops(const DropCounts& drops) noexcept {
+        int64_t socket = drops.socket;
+        const HostNetStats& host = drops.host;
+        if (c.rxqOvfl) {
+            if (socket > 0) LogInfo(ORANGE("   SOCKET DROPS: %lld pkts (SO_RXQ_OVFL)"), (long long)socket);
+            else            LogInfo("   SOCKET DROPS: 0 pkts (SO_RXQ_OVFL)");
+        }
+        if (host.valid) {
+            if (host.hasDrops())
+                LogInfo(ORANGE("   HOST DROPS udp rcvbuf:%lld sndbuf:%lld inerrors:%lld  softnet dropped:%lld squeezed:%lld"),
+                        (long long)host.udpRcvbufErrors, (long long)host.udpSndbufErrors, (long long)host.udpInErrors,
+                        (long long)host.softnetDropped, (long long)host.softnetSqueezed);
+            else
+                LogInfo("   HOST DROPS udp rcvbuf:0 sndbuf:0 inerrors:0  softnet dropped:0 squeezed:0");
+        }
+        if (socket > 0)
+            LogInfo(ORANGE("   socket receive buffer overflowed, raise --rcvbuf (now %s)"),
+                    toLiteral(c.getBufSize(rpp::socket::BO_Recv)));
+        if (host.udpSndbufErrors > 0)
+            LogInfo(ORANGE("   socket send buffer overflowed, raise --sndbuf (now %s)"),
+                    toLiteral(c.getBufSize(rpp::socket::BO_Send)));
+        if (host.softnetDropped > 0)
+            LogInfo(ORANGE("   input backlog overflowed before the socket, raise net.core.netdev_max_backlog"));
+        if (host.softnetSqueezed > 0)
+            LogInfo(ORANGE("   NAPI budget ran out with packets in the NIC ring, raise net.core.netdev_budget"));
+    }
+
+    // --output: the traffic received from our peer, burst records are cumulative since INIT like the summary
+    ResultRecord makeRecord(const char* kind, const TrafficStatus& tr, const DropCounts& drops) const noexcept {
+        ResultRecord r;
+        r.kind = kind;
+        r.role = whoami == EndpointType::CLIENT ? "client" : "server";
+        r.timeMs = nowNanos() / 1'000'000;
+        r.iteration = statusIteration;
+        r.stream = streamIndex;
+        int64_t arrivalNs = tr.lastArrivalNs - tr.firstArrivalNs;
+        r.elapsedMs = arrivalNs / 1'000'000;
+        r.sent = tr.sent;
+        r.received = tr.received;
+        r.reordered = tr.outOfOrderPackets;
+        r.duplicates = tr.duplicatePackets;
+        r.corrupted = tr.invalidData;
+        r.bytesPerSec = tr.arrivalRate();
+        r.packetsPerSec = r.bytesPerSec / std::max(args.mtu, 1);
+        r.latencyP50Ns = tr.oneWay.percentile(50.0);
+        r.latencyP90Ns = tr.oneWay.percentile(90.0);
+        r.latencyP99Ns = tr.oneWay.percentile(99.0);
+        r.latencyP999Ns = tr.oneWay.percentile(99.9);
+        r.latencyMaxNs = tr.oneWay.maxValue;
+        r.rttP50Ns = tr.roundTrip.percentile(50.0);
+        r.rttP99Ns = tr.roundTrip.percentile(99.0);
+        r.rttMaxNs = tr.roundTrip.maxValue;
+        r.jitterNs = tr.jitter.jitter;
+        r.socketDrops = drops.socket;
+        r.udpRcvbufErrors = drops.host.udpRcvbufErrors;
+        r.udpInErrors = drops.host.udpInErrors;
+        r.softnetDropped = drops.host.softnetDropped;
+        return r;
+    }
+
+    // a consistent copy of the traffic counters, which peer shards and the --pipeline worker update
+    TrafficStatus lockedTraffic(EndpointType which) noexcept {
+        if (listener && listener->peers.empty()) {
+            std::lock_guard lock { listener->trafficMutex };
+            return traffic(which);
+        }
+        return sumTraffic(which);
+    }
+
+    // --duration and --output: interval reports, for a server listener one per session
+    void maybeReportInterval() noexcept {
+        if (!args.output && durationSec == 0)
+            return;
+        int64_t now = Pacer::monotonicNs();
+        if (now < nextIntervalNs)
+            return;
+        nextIntervalNs = now + int64_t(args.intervalMs) * 1'000'000;
+        if (whoami == EndpointType::SERVER && !listener) {
+            // other shards insert sessions here, but only this thread erases the ones it owns
+            std::vector<UDPQuality*> owned;
+            {
+                std::lock_guard lock { trafficMutex };
+                for (auto& [key, s] : sessions)
+                    if (s->statusOwner) owned.push_back(s.get());
+            }
+            for (UDPQuality* s : owned) s->reportInterval(now);
+        } else {
+            reportInterval(now);
+        }
+    }
+
+    // server session: DATA from addresses without a session, since the server started
+    void printUnknownData() noexcept {
+        int64_t strays = 0;
+        forEachShard([&](UDPQuality& shard) {
+            std::lock_guard lock { shard.trafficMutex };
+            strays += shard.unknownCh.received;
+        });
+        if (strays > 0)
+            LogInfo(ORANGE("   UNKNOWN DATA %lld pkts from senders without INIT (all clients)"), (long long)strays);
+    }
+
+    void reportInterval(int64_t nowNs) noexcept {
+        if (!args.output && durationSec == 0)
+            return;
+        TrafficStatus now = lockedTraffic(talkingTo);
+        if (reportStartNs == 0)
+            reportStartNs = nowNs;
+        if (intervalStartNs != 0) {
+            // counters restart at INIT, then everything is new
+            TrafficStatus empty;
+            const TrafficStatus& base = now.received >= intervalBase.received ? intervalBase : empty;
+            TrafficStatus delta = now;
+            delta.sent -= base.sent;
+            delta.received -= base.received;
+            delta.outOfOrderPackets -= base.outOfOrderPackets;
+            delta.duplicatePackets -= base.duplicatePackets;
+            delta.invalidData -= base.invalidData;
+            delta.oneWay.subtract(base.oneWay);
+            delta.roundTrip.subtract(base.roundTrip);
+
+            int64_t elapsedNs = std::max<int64_t>(nowNs - intervalStartNs, 1);
+            // arrivals restart every burst
+            int64_t bytes = now.arrivedBytes >= base.arrivedBytes ? now.arrivedBytes - base.arrivedBytes : now.arrivedBytes;
+            ResultRecord r = makeRecord("interval", delta, dropsSince(intervalSocketDrops, intervalHost));
+            r.elapsedMs = elapsedNs / 1'000'000;
+            r.bytesPerSec = bytes * 1e9 / elapsedNs;
+            r.packetsPerSec = delta.received * 1e9 / elapsedNs;
+            // only reordered packets are below the highest seqid and still in flight
+            r.setExpected(int64_t(now.highestSeqId - base.highestSeqId) + delta.duplicatePackets);
+            r.peerReceived = now.lastStatus.dataReceived - base.lastStatus.dataReceived;
+            if (args.output) args.output->write(r);
+            if (durationSec > 0) printInterval(r, nowNs);
+        }
+        intervalBase = std::move(now);
+        intervalStartNs = nowNs;
+        intervalSocketDrops = sumSocketDrops();
+        intervalHost = HostNetStats::read();
+    }
+
+    // --duration: one line per interval
+    void printInterval(const ResultRecord& r, int64_t nowNs) noexcept {
+        trackLossBurst(r.timeMs - r.elapsedMs, r.timeMs, r.lost);
+        if (r.sent == 0 && r.received == 0)
+            return; // idle, waiting for the peer to finish
+        int64_t elapsedMs = std::max<int64_t>(r.elapsedMs, 1);
+        LogInfo("   INTERVAL %7.1fs  tx:%s/s  rx:%s/s  recv:%lld  lost:%lld (%.3f%%)  reorder:%lld  dup:%lld  corrupt:%lld  p99:%s  rtt p99:%s  jitter:%s",
+                (nowNs - reportStartNs) / 1e9,
+                toLiteral(r.sent * args.mtu * 1000 / elapsedMs), toLiteral(int64_t(r.bytesPerSec)),
+                (long long)r.received, (long long)r.lost, r.lossPercent,
+                (long long)r.reordered, (long long)r.duplicates, (long long)r.corrupted,
+                toDurationLiteral(r.latencyP99Ns), toDurationLiteral(r.rttP99Ns), toDurationLiteral(int64_t(r.jitterNs)));
+    }
+
+    // consecutive intervals with loss are one loss burst, reported with its wall clock time once it ends
+    void trackLossBurst(int64_t startMs, int64_t endMs, int64_t lost) noexcept {
+        if (lost <= 0) {
+            endLossBurst();
+            return;
+        }
+        if (lossBurstStartMs == 0) {
+            lossBurstStartMs = startMs;
+            lossBurstLost = 0;
+        }
+        lossBurstEndMs = endMs;
+        lossBurstLost += lost;
+    }
+
+    void endLossBurst() noexcept {
+        if (lossBurstStartMs == 0)
+            return;
+        int64_t lengthMs = lossBurstEndMs - lossBurstStartMs;
+        ++lossBursts;
+        longestLossBurstMs = std::max(longestLossBurstMs, lengthMs);
+        LogInfo(RED("   LOSS BURST at %s for %.1fs  lost:%lld pkts"),
+                toTimeOfDay(lossBurstStartMs), lengthMs / 1000.0, (long long)lossBurstLost);
+        lossBurstStartMs = 0;
+    }
+
+    void printLossBursts() noexcept {
+        endLossBurst();
+        if (lossBursts > 0) LogInfo(RED("   LOSS BURSTS %d  longest:%.1fs"), lossBursts, longestLossBurstMs / 1000.0);
+        else                LogInfo(GREEN("   LOSS BURSTS none"));
+    }
+
+    void printLatency(const char* direction, const TrafficStatus& tr) const noexcept {
+        tr.oneWay.print(direction);
+        if (tr.jitter.started)
+            LogInfo("   %s JITTER %s (RFC 3550)", direction, toDurationLiteral(int64_t(tr.jitter.jitter)));
+        if (tr.arrivalGap.total > 0) {
+            LogInfo("   %s ARRIVAL rate:%s", direction, toRateLiteral(int64_t(tr.arrivalRate())));
+            tr.arrivalGap.print(direction, "ARRIVAL GAP");
+        }
+    }
+
+    // CPU per gigabit: cpu-seconds spent to move 1Gbit, lower is better
+    void printBurstCost(const char* what) const noexcept {
+        const BurstCost& b = burstCost;
+        if (b.packets == 0 || b.elapsedNs <= 0)
+            return;
+        double seconds = b.elapsedNs / 1e9;
+        double gbits = b.bytes * 8 / 1e9;
+        LogInfo("   %s THROUGHPUT %.0f pps  %.3f Gbit/s  cpu:%s  %.3f cpu-sec/Gbit", what,
+                b.packets / seconds, gbits / seconds, toDurationLiteral(b.cpuNs), (b.cpuNs / 1e9) / gbits);
+    }
+
+    void printIOStats() const noexcept {
+        const UDPConnection::IOStats& io = c.stats;
+        LogInfo("   SYSCALLS engine:%s batch:%d  send:%lld calls %.3f/pkt  recv:%lld calls %.3f/pkt  poll:%lld calls %.3f/pkt",
+                UDPConnection::engineName(c.engine()), c.batchSize, (long long)io.sendCalls, io.sendCallsPerPacket(),
+                (long long)io.recvCalls, io.recvCallsPerPacket(), (long long)io.pollCalls, io.pollCallsPerPacket());
+        if (c.uring && uring_udp_send_errors(c.uring) > 0)
+            LogInfo(ORANGE("   io_uring send errors: %lld"), (long long)uring_udp_send_errors(c.uring));
+        if (c.xdp && xdp_udp_kernel_sends(c.xdp) > 0)
+            LogInfo(ORANGE("   AF_XDP sent %lld pkts through the kernel until the peer MAC was known"),
+                    (long long)xdp_udp_kernel_sends(c.xdp));
+        c.pacer.printStats();
+        if (c.timestamping) {
+            c.rxQueueDelay.print("RX QUEUE");
+            c.txStackDelay.print("TX STACK");
+            c.txGap.print("TX", "GAP");
+        }
+        PROFILE_PRINT();
+    }
+
+    // high-water near the ring size or full drops: the analysis fell behind and those packets are
+    // our own losses, otherwise anything LOST was dropped before the receive thread got it
+    void printPipelineStats() noexcept {
+        forEachShard([](UDPQuality& shard) {
+            if (!shard.rxRing)
+                return;
+            const SpscRing<RxPacket>& ring = *shard.rxRing;
+            int32_t highWater = ring.highWater.load(std::memory_order_relaxed);
+            int64_t drops = ring.fullDrops.load(std::memory_order_relaxed);
+            if (drops > 0)
+                LogInfo(RED("   PIPELINE shard:%d high-water:%d/%d slots  full-drops:%lld pkts (worker fell behind)"),
+                        shard.shardIndex, highWater, ring.capacity, (long long)drops);
+            else
+                LogInfo("   PIPELINE shard:%d high-water:%d/%d slots (%.1f%%)  full-drops:0",
+                        shard.shardIndex, highWater, ring.capacity, 100.0 * highWater / ring.capacity);
+        });
+    }
+
+    void printReceivedAt(const char* at, int32_t expected, int32_t actual, int32_t corrupted = 0) noexcept {
+        int lost = expected - actual;
+        float p = 100.0f * (float(actual) / std::max(expected,1));
+        if      (p > 99.99f) LogInfo(GREEN( "   %s RECEIVED: %6.2f%% %5dpkts  LOST: %6.2f%% %dpkts"), at, p, actual, 100-p, lost);
+        else if (p > 90.0f)  LogInfo(ORANGE("   %s RECEIVED: %6.2f%% %5dpkts  LOST: %6.2f%% %dpkts"), at, p, actual, 100-p, lost);
+        else                 LogInfo(RED(   "   %s RECEIVED: %6.2f%% %5dpkts  LOST: %6.2f%% %dpkts"), at, p, actual, 100-p, lost);
+        if (corrupted > 0) {
+            LogInfo(RED("   %s RECEIVED CORRUPTED: %d packets"), at, corrupted);
+        }
+    }
+};
+
+// --streams N: N independent client flows, each with its own socket, thread and seqid space
+void runClientStreams(const Args& args) noexcept;
+// --sweep: highest rate below --sweep-loss for every --sweep-buf
+void runClientSweep(const Args& args) noexcept;
+// --mtu-sweep: one test per datagram size
+void runMtuSweep(const Args& args) noexcept;
+// --threads N: SO_REUSEPORT server shards, one thread per core
+void runServerShards(const Args& args) noexcept;
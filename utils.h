@@ -3,6 +3,12 @@
 #include <stdio.h> // sprintf
 #include <rpp/strview.h>
 #include <math.h> // round
+#include <time.h> // clock_gettime
+#if __linux__
+    #include <pthread.h>
+    #include <sched.h>
+    #include <unistd.h> // sysconf
+#endif
 
 static uint32_t parseSizeLiteral(rpp::strview literal) noexcept
 {
@@ -15,16 +21,78 @@ static uint32_t parseSizeLiteral(rpp::strview literal) noexcept
     return uint32_t(ceil(value));
 }
 
-static std::string toLiteral(uint32_t bytes) noexcept
+static std::string toLiteral(int64_t bytes) noexcept
 {
     char buffer[128];
-    if      (bytes < 1000)    sprintf(buffer, "%dB", bytes);
-    else if (bytes < 1000000) sprintf(buffer, "%.2fKB", double(bytes) / 1000.0);
-    else                      sprintf(buffer, "%.2fMB", double(bytes) / 1000000.0);
+    if      (bytes < 1000)       sprintf(buffer, "%lldB", (long long)bytes);
+    else if (bytes < 1000000)    sprintf(buffer, "%.2fKB", double(bytes) / 1000.0);
+    else if (bytes < 1000000000) sprintf(buffer, "%.2fMB", double(bytes) / 1000000.0);
+    else                         sprintf(buffer, "%.2fGB", double(bytes) / 1000000000.0);
     return buffer;
 }
 
-static std::string toRateLiteral(int bytesPerSec) noexcept
+static std::string toRateLiteral(int64_t bytesPerSec) noexcept
 {
     return bytesPerSec > 0 ? toLiteral(bytesPerSec) + "/s" : "unlimited B/s";
 }
+
+static std::string toDurationLiteral(int64_t nanos) noexcept
+{
+    char buffer[128];
+    if      (nanos < 1000)       sprintf(buffer, "%lldns", (long long)nanos);
+    else if (nanos < 1000000)    sprintf(buffer, "%.1fus", double(nanos) / 1e3);
+    else if (nanos < 1000000000) sprintf(buffer, "%.2fms", double(nanos) / 1e6);
+    else                         sprintf(buffer, "%.2fs", double(nanos) / 1e9);
+    return buffer;
+}
+
+// local time of day of a wall clock timestamp: HH:MM:SS.mmm
+static std::string toTimeOfDay(int64_t unixMillis) noexcept
+{
+    time_t seconds = time_t(unixMillis / 1000);
+    tm local;
+    localtime_r(&seconds, &local);
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), "%02d:%02d:%02d.%03d",
+             local.tm_hour, local.tm_min, local.tm_sec, int(unixMillis % 1000));
+    return buffer;
+}
+
+// wall clock in nanoseconds, so one-way latency is meaningful between NTP/PTP synced hosts
+static int64_t nowNanos() noexcept
+{
+    timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return int64_t(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+// CPU time consumed by the calling thread, in nanoseconds
+static int64_t threadCpuNanos() noexcept
+{
+    timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return int64_t(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+// CPU time consumed by all threads of this process, in nanoseconds
+static int64_t processCpuNanos() noexcept
+{
+    timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return int64_t(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+// pins the calling thread to a CPU core, wraps around if there are fewer cores
+static inline bool pinThreadToCore(int core) noexcept
+{
+#if __linux__
+    int numCores = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(core % (numCores > 0 ? numCores : 1), &cpus);
+    return pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus) == 0;
+#else
+    (void)core;
+    return false;
+#endif
+}